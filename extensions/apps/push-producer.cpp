@@ -30,6 +30,8 @@
 #include "model/ndn-l3-protocol.hpp"
 #include "helper/ndn-fib-helper.hpp"
 
+#include "../queues/interest-shaper-queue.hpp"
+
 #include <memory>
 
 NS_LOG_COMPONENT_DEFINE("ndn.PushProducer");
@@ -88,6 +90,9 @@ PushProducer::StartApplication()
   App::StartApplication();
 
   FibHelper::AddRoute(GetNode(), m_prefix, m_face, 0);
+
+  // Lets Interest shapers reserve reverse link capacity for the pushed Data
+  InterestShaperQueue::SetPushRate(m_prefix, m_frequency * m_virtualPayloadSize);
 }
 
 void
@@ -0,0 +1,318 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/log.h"
+#include "ns3/double.h"
+#include "ns3/string.h"
+#include "ns3/trace-source-accessor.h"
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+#include "buffer-partition.hpp"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("BufferPartition");
+
+NS_OBJECT_ENSURE_REGISTERED (BufferPartition);
+
+const uint32_t BufferPartition::CLASSES;
+
+TypeId BufferPartition::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::BufferPartition")
+    .SetParent<Object> ()
+    .SetGroupName("Network")
+    .AddConstructor<BufferPartition> ()
+    .AddAttribute ("Shares",
+                   "Guaranteed and maximum fraction of the queue limit per QCI class, e.g. \"20=0.2:0.5 90=0:0.8\".",
+                   StringValue (""),
+                   MakeStringAccessor (&BufferPartition::SetShares,
+                                       &BufferPartition::GetShares),
+                   MakeStringChecker ())
+    .AddAttribute ("Alpha",
+                   "Dynamic threshold factor: a class may borrow up to Alpha times the free part of the shared pool.",
+                   DoubleValue (1.0),
+                   MakeDoubleAccessor (&BufferPartition::m_alpha),
+                   MakeDoubleChecker<double> (0.0))
+    .AddTraceSource ("Drop",
+                     "The queue dropped a packet of the given QCI class.",
+                     MakeTraceSourceAccessor (&BufferPartition::m_dropTrace),
+                     "ns3::BufferPartition::DropTracedCallback")
+  ;
+
+  return tid;
+}
+
+BufferPartition::BufferPartition () :
+  m_enabled (false),
+  m_alpha (1.0),
+  m_limit (0),
+  m_countBytes (false),
+  m_pool (0),
+  m_poolUsed (0)
+{
+  NS_LOG_FUNCTION (this);
+  m_guaranteedShare.fill(0);
+  m_maxShare.fill(1);
+  m_guaranteed.fill(0);
+  m_max.fill(0);
+  m_packets.fill(0);
+  m_bytes.fill(0);
+  m_dropped.fill(0);
+}
+
+BufferPartition::~BufferPartition ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+BufferPartition::SetShares (std::string shares)
+{
+  NS_LOG_FUNCTION (this << shares);
+
+  std::array<double, CLASSES> guaranteedShare;
+  std::array<double, CLASSES> maxShare;
+  guaranteedShare.fill(0);
+  maxShare.fill(1);
+  double guaranteedSum = 0;
+  bool enabled = false;
+
+  std::string entries = shares;
+  std::replace (entries.begin (), entries.end (), ',', ' ');
+  std::replace (entries.begin (), entries.end (), ';', ' ');
+  std::istringstream is (entries);
+  std::string entry;
+  while (is >> entry) {
+    size_t equal = entry.find('=');
+    size_t colon = entry.find(':', equal);
+    unsigned long qci = 0;
+    double guaranteed = 0;
+    double max = 1;
+    bool valid = equal != std::string::npos;
+    try {
+      size_t parsed = 0;
+      if (valid) {
+        std::string value = entry.substr(0, equal);
+        qci = std::stoul(value, &parsed);
+        valid = parsed == value.size();
+      }
+      if (valid) {
+        std::string value = entry.substr(equal + 1, colon == std::string::npos ? std::string::npos : colon - equal - 1);
+        guaranteed = std::stod(value, &parsed);
+        valid = parsed == value.size();
+      }
+      if (valid && colon != std::string::npos) {
+        std::string value = entry.substr(colon + 1);
+        max = std::stod(value, &parsed);
+        valid = parsed == value.size();
+      }
+    } catch (const std::logic_error&) {
+      valid = false;
+    }
+    if (!valid) {
+      throw std::invalid_argument("Buffer share `" + entry + "` is not of the form qci=guaranteed:maximum");
+    }
+    if (guaranteed < 0 || guaranteed > max || max > 1) {
+      throw std::invalid_argument("Buffer share `" + entry + "` needs 0 <= guaranteed <= maximum <= 1");
+    }
+
+    uint32_t index = Index(qci);
+    guaranteedSum += guaranteed - guaranteedShare[index];
+    guaranteedShare[index] = guaranteed;
+    maxShare[index] = max;
+    enabled = true;
+  }
+
+  if (guaranteedSum > 1) {
+    throw std::invalid_argument("Guaranteed buffer shares `" + shares + "` add up to more than 1");
+  }
+
+  m_guaranteedShare = guaranteedShare;
+  m_maxShare = maxShare;
+  m_enabled = enabled;
+  m_shares = shares;
+  Update();
+}
+
+std::string
+BufferPartition::GetShares (void) const
+{
+  return m_shares;
+}
+
+bool
+BufferPartition::IsEnabled (void) const
+{
+  return m_enabled;
+}
+
+void
+BufferPartition::SetLimit (uint32_t limit, bool bytes)
+{
+  if (limit == m_limit && bytes == m_countBytes) {
+    return;
+  }
+
+  NS_LOG_FUNCTION (this << limit << bytes);
+  m_limit = limit;
+  m_countBytes = bytes;
+  Update();
+}
+
+bool
+BufferPartition::Admit (uint32_t qci, uint32_t size, uint32_t freedPackets, uint32_t freedBytes) const
+{
+  if (!m_enabled) {
+    return true;
+  }
+
+  if (!FitsMaximum(qci, size, freedPackets, freedBytes)) {
+    NS_LOG_LOGIC ("QCI " << qci << " reached its maximum share of " << m_max[Index(qci)]);
+    return false;
+  }
+
+  uint32_t index = Index(qci);
+  uint64_t used = GetUsed(index, freedPackets, freedBytes);
+  uint64_t needed = used + (m_countBytes ? size : 1);
+  if (Fits(needed, m_guaranteed[index])) {
+    return true;
+  }
+
+  // The dropped packets give their part of the pool back
+  uint64_t excess = GetExcess(index, used);
+  uint64_t poolUsed = m_poolUsed - (GetExcess(index, GetUsed(index)) - excess);
+  uint64_t borrowed = needed - std::max(m_guaranteed[index], used);
+  if (poolUsed > m_pool || !Fits(borrowed, m_pool - poolUsed)) {
+    NS_LOG_LOGIC ("Shared buffer pool is exhausted for QCI " << qci);
+    return false;
+  }
+
+  // Choudhury-Hahne: a class may grow while it holds less than Alpha times the free pool
+  if (excess >= m_alpha * (m_pool - poolUsed)) {
+    NS_LOG_LOGIC ("QCI " << qci << " holds " << excess << " of the shared pool, over its dynamic threshold");
+    return false;
+  }
+  return true;
+}
+
+bool
+BufferPartition::FitsMaximum (uint32_t qci, uint32_t size, uint32_t freedPackets, uint32_t freedBytes) const
+{
+  if (!m_enabled) {
+    return true;
+  }
+
+  uint32_t index = Index(qci);
+  return Fits(GetUsed(index, freedPackets, freedBytes) + (m_countBytes ? size : 1), m_max[index]);
+}
+
+bool
+BufferPartition::IsBorrowing (uint32_t qci) const
+{
+  uint32_t index = Index(qci);
+  return m_enabled && GetExcess(index, GetUsed(index)) > 0;
+}
+
+void
+BufferPartition::Add (uint32_t qci, uint32_t size)
+{
+  uint32_t index = Index(qci);
+  uint64_t excess = GetExcess(index, GetUsed(index));
+
+  m_packets[index]++;
+  m_bytes[index] += size;
+
+  m_poolUsed += GetExcess(index, GetUsed(index)) - excess;
+}
+
+void
+BufferPartition::Remove (uint32_t qci, uint32_t size)
+{
+  uint32_t index = Index(qci);
+  uint64_t excess = GetExcess(index, GetUsed(index));
+
+  NS_ASSERT (m_packets[index] > 0 && m_bytes[index] >= size);
+  m_packets[index]--;
+  m_bytes[index] -= size;
+
+  m_poolUsed -= excess - GetExcess(index, GetUsed(index));
+}
+
+void
+BufferPartition::NotifyDrop (Ptr<const Packet> packet, uint32_t qci)
+{
+  m_dropped[Index(qci)]++;
+  m_dropTrace(packet, qci);
+}
+
+uint64_t
+BufferPartition::GetNDroppedPackets (uint32_t qci) const
+{
+  return m_dropped[Index(qci)];
+}
+
+uint32_t
+BufferPartition::Index (uint32_t qci)
+{
+  return std::min(qci, CLASSES - 1);
+}
+
+uint64_t
+BufferPartition::GetUsed (uint32_t index) const
+{
+  return m_countBytes ? m_bytes[index] : m_packets[index];
+}
+
+uint64_t
+BufferPartition::GetUsed (uint32_t index, uint32_t freedPackets, uint32_t freedBytes) const
+{
+  uint64_t used = GetUsed(index);
+  uint64_t freed = m_countBytes ? freedBytes : freedPackets;
+  return used > freed ? used - freed : 0;
+}
+
+uint64_t
+BufferPartition::GetExcess (uint32_t index, uint64_t used) const
+{
+  return used > m_guaranteed[index] ? used - m_guaranteed[index] : 0;
+}
+
+bool
+BufferPartition::Fits (uint64_t needed, uint64_t limit) const
+{
+  // The queues compare packets with <= and bytes with < against their limit
+  return m_countBytes ? needed < limit : needed <= limit;
+}
+
+void
+BufferPartition::Update (void)
+{
+  uint64_t guaranteedSum = 0;
+  m_poolUsed = 0;
+  for (uint32_t index = 0; index < CLASSES; index++) {
+    m_guaranteed[index] = static_cast<uint64_t>(m_guaranteedShare[index] * m_limit);
+    m_max[index] = static_cast<uint64_t>(m_maxShare[index] * m_limit);
+    guaranteedSum += m_guaranteed[index];
+    m_poolUsed += GetExcess(index, GetUsed(index));
+  }
+  m_pool = m_limit > guaranteedSum ? m_limit - guaranteedSum : 0;
+}
+
+} // namespace ns3
@@ -0,0 +1,197 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef BUFFERPARTITION_H
+#define BUFFERPARTITION_H
+
+#include <array>
+#include <string>
+#include "ns3/object.h"
+#include "ns3/packet.h"
+#include "ns3/traced-callback.h"
+
+#include "flow-classifier.hpp"
+
+namespace ns3 {
+
+/**
+ * \ingroup queue
+ *
+ * \brief Per-QCI buffer shares and admission control of a queue
+ *
+ * Without shares, all classes compete for the MaxPackets or MaxBytes of the
+ * queue, and a burst of bulk traffic can fill the buffer and tail-drop voice.
+ * The Shares attribute gives classes a guaranteed and a maximum fraction of
+ * the buffer, e.g. "20=0.2:0.5 90=0:0.8". Classes without an entry have no
+ * guarantee and may use the whole buffer.
+ *
+ * A class is always admitted within its guaranteed share. Beyond it, the
+ * class borrows from the shared pool, which is the buffer minus all
+ * guarantees, with a dynamic threshold (Choudhury and Hahne): a packet is
+ * admitted while the class uses less of the pool than Alpha times the free
+ * part of the pool. Idle classes leave the pool to the busy ones, and a
+ * single class cannot take all of it. The maximum share caps the class in
+ * any case. Shares are compared like the queue compares its own limit, a
+ * byte share is exhausted when it would be filled up completely.
+ *
+ * The queue reports every packet it adds, removes and drops, which keeps the
+ * occupancy of every class and of the shared pool in O(1) per packet. The
+ * Drop trace source reports every dropped packet with its class:
+ *
+ *     Config::ConnectWithoutContext ("/NodeList/0/DeviceList/0/TxQueue/BufferPartition/Drop", ...);
+ */
+class BufferPartition : public Object {
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+
+  BufferPartition ();
+
+  virtual ~BufferPartition();
+
+  /**
+   * \brief Sets the guaranteed and maximum shares of the classes
+   *
+   * \param shares List of `qci=guaranteed:maximum` entries separated by
+   * whitespace, `,` or `;`, the shares are fractions of the queue limit. The
+   * maximum may be omitted and defaults to 1. The guarantees must not add up
+   * to more than 1.
+   *
+   * \throw std::invalid_argument if an entry cannot be parsed
+   */
+  void SetShares (std::string shares);
+
+  std::string GetShares (void) const;
+
+  /**
+   * \return Whether any class has a share
+   */
+  bool IsEnabled (void) const;
+
+  /**
+   * \brief Sets the queue limit the shares refer to
+   *
+   * \param limit MaxPackets or MaxBytes of the queue
+   * \param bytes Whether the limit and the shares count bytes instead of packets
+   */
+  void SetLimit (uint32_t limit, bool bytes);
+
+  /**
+   * \return Whether a packet of the given class and size fits the shares
+   *
+   * \param freedPackets Queued packets of the class the queue drops to make room for it
+   * \param freedBytes Bytes of these packets
+   */
+  bool Admit (uint32_t qci, uint32_t size, uint32_t freedPackets = 0, uint32_t freedBytes = 0) const;
+
+  /**
+   * \return Whether a packet of the given class and size fits the maximum share of the class
+   *
+   * \param freedPackets Queued packets of the class the queue drops to make room for it
+   * \param freedBytes Bytes of these packets
+   */
+  bool FitsMaximum (uint32_t qci, uint32_t size, uint32_t freedPackets = 0, uint32_t freedBytes = 0) const;
+
+  /**
+   * \return Whether the class holds more than its guarantee, so dropping
+   * its packets frees the shared pool
+   */
+  bool IsBorrowing (uint32_t qci) const;
+
+  /**
+   * \brief Accounts a packet the queue added
+   */
+  void Add (uint32_t qci, uint32_t size);
+
+  /**
+   * \brief Accounts a packet which left the queue, dequeued or dropped
+   */
+  void Remove (uint32_t qci, uint32_t size);
+
+  /**
+   * \brief Reports a dropped packet, the arriving one or a queued one
+   */
+  void NotifyDrop (Ptr<const Packet> packet, uint32_t qci);
+
+  /**
+   * \return The number of packets of the given class dropped by the queue
+   */
+  uint64_t GetNDroppedPackets (uint32_t qci) const;
+
+  /**
+   * TracedCallback signature for dropped packets.
+   *
+   * \param [in] packet The dropped packet
+   * \param [in] qci QCI class of the packet
+   */
+  typedef void (* DropTracedCallback)(Ptr<const Packet> packet, uint32_t qci);
+
+private:
+  static const uint32_t CLASSES = ndn::FlowClassifier::QCI_BUCKETS;
+
+  /**
+   * \return The class index of a QCI value
+   */
+  static uint32_t Index (uint32_t qci);
+
+  /**
+   * \return The occupancy of a class index in the unit of the limit
+   */
+  uint64_t GetUsed (uint32_t index) const;
+
+  /**
+   * \return The occupancy of a class index once the given packets are dropped
+   */
+  uint64_t GetUsed (uint32_t index, uint32_t freedPackets, uint32_t freedBytes) const;
+
+  /**
+   * \return The part of a class index' occupancy beyond its guarantee
+   */
+  uint64_t GetExcess (uint32_t index, uint64_t used) const;
+
+  /**
+   * \return Whether an occupancy stays within a limit, compared like the queue limit
+   */
+  bool Fits (uint64_t needed, uint64_t limit) const;
+
+  /**
+   * \brief Computes the limits of the classes and the pool usage from scratch
+   */
+  void Update (void);
+
+  std::array<double, CLASSES> m_guaranteedShare;  //!< guaranteed fraction of every class
+  std::array<double, CLASSES> m_maxShare;         //!< maximum fraction of every class
+  std::array<uint64_t, CLASSES> m_guaranteed;     //!< guaranteed packets or bytes of every class
+  std::array<uint64_t, CLASSES> m_max;            //!< maximum packets or bytes of every class
+  std::array<uint32_t, CLASSES> m_packets;        //!< queued packets of every class
+  std::array<uint64_t, CLASSES> m_bytes;          //!< queued bytes of every class
+  std::array<uint64_t, CLASSES> m_dropped;        //!< dropped packets of every class
+  std::string m_shares;                           //!< shares as given to SetShares
+  bool m_enabled;                                 //!< whether any class has a share
+  double m_alpha;                                 //!< dynamic threshold factor
+  uint32_t m_limit;                               //!< queue limit
+  bool m_countBytes;                              //!< whether the limit counts bytes
+  uint64_t m_pool;                                //!< size of the shared pool
+  uint64_t m_poolUsed;                            //!< excess of all classes over their guarantees
+  TracedCallback<Ptr<const Packet>, uint32_t> m_dropTrace; //!< fired for every dropped packet
+};
+
+} // namespace ns3
+
+#endif /* BUFFERPARTITION_H */
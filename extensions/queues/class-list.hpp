@@ -0,0 +1,68 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef CLASSLIST_H
+#define CLASSLIST_H
+
+#include <inttypes.h>
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "flow-classifier.hpp"
+
+namespace ns3 {
+
+/**
+ * \brief Splits a list of `qci=value` entries separated by whitespace, `,` or `;`
+ *
+ * \throw std::invalid_argument if an entry is not of that form
+ */
+inline std::vector<std::pair<uint32_t, std::string> >
+parseClassList (const std::string& list)
+{
+  std::vector<std::pair<uint32_t, std::string> > entries;
+
+  std::string text = list;
+  std::replace (text.begin (), text.end (), ',', ' ');
+  std::replace (text.begin (), text.end (), ';', ' ');
+  std::istringstream is (text);
+  std::string entry;
+  while (is >> entry) {
+    size_t equal = entry.find('=');
+    size_t parsed = 0;
+    unsigned long qci = 0;
+    if (equal != std::string::npos && equal + 1 < entry.size()) {
+      try {
+        qci = std::stoul(entry.substr(0, equal), &parsed);
+      } catch (const std::logic_error&) {
+        parsed = 0;
+      }
+    }
+    if (parsed == 0 || parsed != equal || qci >= ndn::FlowClassifier::QCI_BUCKETS) {
+      throw std::invalid_argument("Class list entry `" + entry + "` is not of the form qci=value");
+    }
+    entries.push_back(std::make_pair(static_cast<uint32_t>(qci), entry.substr(equal + 1)));
+  }
+  return entries;
+}
+
+} // namespace ns3
+
+#endif /* CLASSLIST_H */
@@ -0,0 +1,164 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef DEFICITROUNDROBIN_H
+#define DEFICITROUNDROBIN_H
+
+#include <inttypes.h>
+#include <vector>
+
+#include "flow-ring.hpp"
+#include "flow-table.hpp"
+
+namespace ns3 {
+
+/**
+ * \brief Deficit Round Robin over the traffic flows of a queue
+ *
+ * Keeps the deficit, the quantum and the active list link of every flow id.
+ * The active flows form one or more rounds, e.g. one per QCI class, which
+ * share these per-flow arrays. The first flow of a round can always afford
+ * its head packet, so serving a round is O(1) as long as the quanta are not
+ * smaller than the packets.
+ */
+class DeficitRoundRobin
+{
+public:
+  /**
+   * \brief The active flows of one round robin, linked through the flow ids
+   */
+  struct Round
+  {
+    uint32_t first = FlowTable::INVALID_FLOW; //!< flow served next, its deficit covers its head packet
+    uint32_t last = FlowTable::INVALID_FLOW;  //!< flow served last in the current round
+  };
+
+  /**
+   * \brief Makes room for the state of the given number of flow ids
+   */
+  void
+  resize (uint32_t flows)
+  {
+    if (flows > m_deficit.size ())
+      {
+        m_deficit.resize (flows);
+        m_quantum.resize (flows);
+        m_next.resize (flows);
+      }
+  }
+
+  /**
+   * \brief Appends a flow which got its first packet to a round
+   *
+   * \param queues Queues of all flows, indexed by flow id
+   */
+  void
+  activate (Round& round, uint32_t flowId, uint32_t quantum, const std::vector<FlowRing>& queues)
+  {
+    m_quantum[flowId] = quantum;
+    m_deficit[flowId] = quantum;
+    m_next[flowId] = FlowTable::INVALID_FLOW;
+    if (round.last == FlowTable::INVALID_FLOW)
+      {
+        round.first = flowId;
+        round.last = flowId;
+        advance (round, queues);
+      }
+    else
+      {
+        m_next[round.last] = flowId;
+        round.last = flowId;
+      }
+  }
+
+  /**
+   * \brief Returns the bytes a flow may still send in the current round
+   */
+  uint32_t
+  deficit (uint32_t flowId) const
+  {
+    return m_deficit[flowId];
+  }
+
+  /**
+   * \brief Returns the flow after the given one in its round, INVALID_FLOW for the last
+   */
+  uint32_t
+  next (uint32_t flowId) const
+  {
+    return m_next[flowId];
+  }
+
+  /**
+   * \brief Charges the bytes of a sent packet to the deficit of a flow
+   */
+  void
+  charge (uint32_t flowId, uint32_t bytes)
+  {
+    m_deficit[flowId] -= bytes;
+  }
+
+  /**
+   * \brief Removes the first flow of a round, which ran empty, it loses its deficit
+   */
+  void
+  removeFirst (Round& round)
+  {
+    round.first = m_next[round.first];
+    if (round.first == FlowTable::INVALID_FLOW)
+      {
+        round.last = FlowTable::INVALID_FLOW;
+      }
+  }
+
+  /**
+   * \brief Rotates a round until the first flow can send its head packet
+   *
+   * \param queues Queues of all flows, indexed by flow id
+   */
+  void
+  advance (Round& round, const std::vector<FlowRing>& queues)
+  {
+    if (round.first == FlowTable::INVALID_FLOW)
+      {
+        return;
+      }
+
+    // A flow which cannot afford its head packet ends its round and gets
+    // the quantum of the next round
+    while (m_deficit[round.first] < queues[round.first].bytes (0))
+      {
+        uint32_t flowId = round.first;
+        m_deficit[flowId] += m_quantum[flowId];
+        if (m_next[flowId] != FlowTable::INVALID_FLOW)
+          {
+            round.first = m_next[flowId];
+            m_next[flowId] = FlowTable::INVALID_FLOW;
+            m_next[round.last] = flowId;
+            round.last = flowId;
+          }
+      }
+  }
+
+private:
+  std::vector<uint32_t> m_deficit; //!< deficit counter of every flow, indexed by flow id
+  std::vector<uint32_t> m_quantum; //!< quantum of every flow, indexed by flow id
+  std::vector<uint32_t> m_next;    //!< successor in the round, indexed by flow id
+};
+
+} // namespace ns3
+
+#endif /* DEFICITROUNDROBIN_H */
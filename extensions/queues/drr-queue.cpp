@@ -0,0 +1,314 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2007 University of Washington
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/log.h"
+#include "ns3/enum.h"
+#include "ns3/uinteger.h"
+#include "ns3/string.h"
+#include "ns3/pointer.h"
+#include "ns3/simulator.h"
+
+#include <limits>
+#include <stdexcept>
+
+#include "drr-queue.hpp"
+#include "class-list.hpp"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("DrrQueue");
+
+NS_OBJECT_ENSURE_REGISTERED (DrrQueue);
+
+TypeId DrrQueue::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::DrrQueue")
+    .SetParent<Queue> ()
+    .SetGroupName("Network")
+    .AddConstructor<DrrQueue> ()
+    .AddAttribute ("Mode",
+                   "Whether to use bytes (see MaxBytes) or packets (see MaxPackets) as the maximum queue size metric.",
+                   EnumValue (QUEUE_MODE_PACKETS),
+                   MakeEnumAccessor (&DrrQueue::SetMode,
+                                     &DrrQueue::GetMode),
+                   MakeEnumChecker (QUEUE_MODE_BYTES, "QUEUE_MODE_BYTES",
+                                    QUEUE_MODE_PACKETS, "QUEUE_MODE_PACKETS"))
+    .AddAttribute ("MaxPackets",
+                   "The maximum number of packets accepted by this DrrQueue.",
+                   UintegerValue (100),
+                   MakeUintegerAccessor (&DrrQueue::m_maxPackets),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("MaxBytes",
+                   "The maximum number of bytes accepted by this DrrQueue.",
+                   UintegerValue (100 * 1024),
+                   MakeUintegerAccessor (&DrrQueue::m_maxBytes),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("Quantum",
+                   "The bytes a flow may send per round, unless its QCI class has an own quantum.",
+                   UintegerValue (1500),
+                   MakeUintegerAccessor (&DrrQueue::m_quantum),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("Quanta",
+                   "Quanta in bytes of QCI classes, e.g. \"20=3000 90=500\", other classes use Quantum.",
+                   StringValue (""),
+                   MakeStringAccessor (&DrrQueue::SetQuanta,
+                                       &DrrQueue::GetQuanta),
+                   MakeStringChecker ())
+    .AddAttribute ("Classifier",
+                   "Rules for separating traffic flows by name prefix, e.g. \"/=2 /video=4\" (see ndn::FlowClassifier::setRules).",
+                   StringValue (""),
+                   MakeStringAccessor (&DrrQueue::SetClassifier,
+                                       &DrrQueue::GetClassifier),
+                   MakeStringChecker ())
+    .AddAttribute ("SojournStats",
+                   "The sojourn time histograms of the packets leaving this queue, per QCI class and traffic flow. Packets dropped from the queue, e.g. by the CoDel of FqCoDelQueue, are not recorded.",
+                   TypeId::ATTR_GET,
+                   PointerValue (),
+                   MakePointerAccessor (&DrrQueue::m_sojournStats),
+                   MakePointerChecker<SojournStats> ())
+  ;
+
+  return tid;
+}
+
+DrrQueue::DrrQueue () :
+  Queue (),
+  m_qciQuantum (),
+  m_bytesInQueue (0),
+  m_packetsInQueue (0)
+{
+  NS_LOG_FUNCTION (this);
+  m_sojournStats = CreateObject<SojournStats> ();
+}
+
+DrrQueue::~DrrQueue ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+DrrQueue::SetMode (DrrQueue::QueueMode mode)
+{
+  NS_LOG_FUNCTION (this << mode);
+  m_mode = mode;
+}
+
+DrrQueue::QueueMode
+DrrQueue::GetMode (void) const
+{
+  NS_LOG_FUNCTION (this);
+  return m_mode;
+}
+
+void
+DrrQueue::SetClassifier (std::string rules)
+{
+  NS_LOG_FUNCTION (this << rules);
+  m_classifier.setRules(rules);
+}
+
+std::string
+DrrQueue::GetClassifier (void) const
+{
+  return m_classifier.getRules();
+}
+
+void
+DrrQueue::SetQuantum (uint32_t qci, uint32_t quantum)
+{
+  NS_LOG_FUNCTION (this << qci << quantum);
+  NS_ASSERT_MSG (qci < m_qciQuantum.size(), "QCI class out of range");
+  m_qciQuantum[qci] = quantum;
+}
+
+void
+DrrQueue::SetQuanta (std::string quanta)
+{
+  NS_LOG_FUNCTION (this << quanta);
+
+  std::array<uint32_t, ndn::FlowClassifier::QCI_BUCKETS> values = {};
+  for (const auto& entry : parseClassList(quanta)) {
+    size_t parsed = 0;
+    unsigned long quantum = 0;
+    try {
+      quantum = std::stoul(entry.second, &parsed);
+    } catch (const std::logic_error&) {
+      parsed = 0;
+    }
+    if (parsed != entry.second.size() || quantum == 0 || quantum > std::numeric_limits<uint32_t>::max()) {
+      throw std::invalid_argument("Quantum `" + entry.second + "` is not a positive number");
+    }
+    values[entry.first] = quantum;
+  }
+
+  m_qciQuantum = values;
+  m_quanta = quanta;
+}
+
+std::string
+DrrQueue::GetQuanta (void) const
+{
+  return m_quanta;
+}
+
+uint32_t
+DrrQueue::GetQuantum (uint32_t qci) const
+{
+  if (qci < m_qciQuantum.size() && m_qciQuantum[qci] > 0) {
+    return m_qciQuantum[qci];
+  }
+  return m_quantum;
+}
+
+uint32_t
+DrrQueue::GetNFlows (void) const
+{
+  return m_flows.size();
+}
+
+uint32_t
+DrrQueue::GetNFlowPackets (uint64_t flowKey) const
+{
+  uint32_t flowId = m_flows.find(flowKey);
+  if (flowId == FlowTable::INVALID_FLOW) {
+    return 0;
+  }
+  return m_queues[flowId].size();
+}
+
+bool
+DrrQueue::DoEnqueue (Ptr<Packet> p)
+{
+  NS_LOG_FUNCTION (this << p);
+
+  ndn::FlowInfo info = m_classifier.classify(p);
+  uint64_t flowKey = info.flowKey;
+
+  NS_LOG_DEBUG("Queuing packet of flow " << flowKey);
+
+  if (m_mode == QUEUE_MODE_PACKETS && (m_packetsInQueue >= m_maxPackets))
+    {
+      NS_LOG_LOGIC ("Queue full (at max packets) -- droppping pkt");
+      Drop (p);
+      return false;
+    }
+
+  if (m_mode == QUEUE_MODE_BYTES && (m_bytesInQueue + p->GetSize () >= m_maxBytes))
+    {
+      NS_LOG_LOGIC ("Queue full (packet would exceed max bytes) -- droppping pkt");
+      Drop (p);
+      return false;
+    }
+
+  m_bytesInQueue += p->GetSize ();
+  m_packetsInQueue++;
+
+  // Look up the flow, flows without queued packets get a new id
+  bool isNew = false;
+  uint32_t flowId = m_flows.intern(flowKey, isNew);
+  if (flowId >= m_queues.size()) {
+    m_queues.resize(flowId + 1);
+    m_drr.resize(flowId + 1);
+  }
+
+  m_queues[flowId].push_back(p, info.qci, flowKey, Simulator::Now());
+
+  if (isNew) {
+    activate(flowId);
+  }
+
+  NS_LOG_LOGIC ("Number packets " << m_packetsInQueue);
+  NS_LOG_LOGIC ("Number bytes " << m_bytesInQueue);
+  NS_LOG_LOGIC ("Number of queues " << m_flows.size());
+
+  return true;
+}
+
+Ptr<Packet>
+DrrQueue::DoDequeue (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  if (m_packetsInQueue == 0)
+  {
+    NS_LOG_LOGIC ("Queue empty");
+    return 0;
+  }
+
+  NS_LOG_LOGIC("Dequeu Packet from Queue " << m_flows.getKey(m_round.first));
+
+  const FlowRing& queue = m_queues[m_round.first];
+  m_sojournStats->Record(queue.qci(0), queue.flowKey(0), Simulator::Now() - queue.enqueueTime(0));
+  Ptr<Packet> p = popFirst(true);
+
+  NS_LOG_LOGIC ("Popped " << p);
+
+  NS_LOG_LOGIC ("Number packets " << m_packetsInQueue);
+  NS_LOG_LOGIC ("Number bytes " << m_bytesInQueue);
+  NS_LOG_LOGIC ("Number of queues " << m_flows.size());
+
+  return p;
+}
+
+Ptr<const Packet>
+DrrQueue::DoPeek (void) const
+{
+  NS_LOG_FUNCTION (this);
+
+  if (m_packetsInQueue == 0)
+    {
+      NS_LOG_LOGIC ("Queue empty");
+      return 0;
+    }
+
+  NS_LOG_LOGIC("Peek Packet from Queue " << m_flows.getKey(m_round.first));
+
+  return m_queues[m_round.first].packet(0);
+}
+
+Ptr<Packet>
+DrrQueue::popFirst(bool charge)
+{
+  uint32_t flowId = m_round.first;
+  FlowRing& queue = m_queues[flowId];
+  if (charge) {
+    m_drr.charge(flowId, queue.bytes(0));
+  }
+  Ptr<Packet> p = queue.pop_front();
+
+  if (queue.empty()) {
+    // Idle flows leave the round and lose their deficit
+    NS_LOG_LOGIC("Erase queue for flow " << m_flows.getKey(flowId));
+    m_flows.release(flowId);
+    m_drr.removeFirst(m_round);
+  }
+  m_drr.advance(m_round, m_queues);
+
+  m_bytesInQueue -= p->GetSize ();
+  m_packetsInQueue--;
+  return p;
+}
+
+void
+DrrQueue::activate(uint32_t flowId)
+{
+  // The quantum is taken from the QCI class of the first packet
+  m_drr.activate(m_round, flowId, GetQuantum(m_queues[flowId].qci(0)), m_queues);
+}
+
+} // namespace ns3
@@ -0,0 +1,171 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2007 University of Washington
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef DRRQUEUE_H
+#define DRRQUEUE_H
+
+#include <array>
+#include <vector>
+#include <string>
+#include "ns3/packet.h"
+#include "ns3/queue.h"
+
+#include "deficit-round-robin.hpp"
+#include "flow-classifier.hpp"
+#include "flow-ring.hpp"
+#include "flow-table.hpp"
+#include "sojourn-stats.hpp"
+
+namespace ns3 {
+
+/**
+ * \ingroup queue
+ *
+ * \brief A Deficit Round Robin packet queue with tail-drop drop policy.
+ *
+ * Deficit Round Robin (DRR) serves the traffic flows in round robin order,
+ * but every flow may only send as many bytes per round as its quantum allows.
+ * Unused quantum is carried over to the next round as the flow's deficit.
+ * Flows with small packets (Interests) and flows with large packets (Data)
+ * therefore get the same share of bytes, at O(1) cost per packet as long as
+ * the quanta are not smaller than the packets.
+ *
+ * The quantum of a flow is taken from the QCI class of its first packet, see
+ * the Quanta attribute. Traffic flows are separated like in FairQueue, by the first two
+ * name components.
+ */
+class DrrQueue : public Queue {
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+  /**
+   * \brief DrrQueue Constructor
+   *
+   * Creates a DRR queue with a maximum size of 100 packets by default
+   */
+  DrrQueue ();
+
+  virtual ~DrrQueue();
+
+  /**
+   * Set the operating mode of this device.
+   *
+   * \param mode The operating mode of this device.
+   *
+   */
+  void SetMode (DrrQueue::QueueMode mode);
+
+  /**
+   * Get the encapsulation mode of this device.
+   *
+   * \returns The encapsulation mode of this device.
+   */
+  DrrQueue::QueueMode GetMode (void) const;
+
+  /**
+   * \brief Sets the rules which separate traffic flows by name prefix
+   *
+   * \param rules Rules as accepted by ndn::FlowClassifier::setRules
+   */
+  void SetClassifier (std::string rules);
+
+  std::string GetClassifier (void) const;
+
+  /**
+   * \brief Sets the quantum of flows of the given QCI class
+   *
+   * Applies to flows becoming active afterwards. Classes without an own
+   * quantum use the Quantum attribute.
+   *
+   * \param qci The QCI class
+   * \param quantum Bytes per round, 0 restores the default quantum
+   */
+  void SetQuantum (uint32_t qci, uint32_t quantum);
+
+  /**
+   * \return The quantum of flows of the given QCI class
+   */
+  uint32_t GetQuantum (uint32_t qci) const;
+
+  /**
+   * \brief Sets the quanta of the QCI classes from a list
+   *
+   * \param quanta List of `qci=bytes` entries separated by whitespace, `,`
+   * or `;`. Classes which are not listed use the Quantum attribute. Like
+   * SetQuantum, the quanta apply to flows becoming active afterwards.
+   *
+   * \throw std::invalid_argument if an entry cannot be parsed
+   */
+  void SetQuanta (std::string quanta);
+
+  std::string GetQuanta (void) const;
+
+  /**
+   * \return The number of traffic flows that currently have packets in the queue
+   */
+  uint32_t GetNFlows (void) const;
+
+  /**
+   * \return The number of packets of the given traffic flow in the queue
+   *
+   * \param flowKey Flow key as computed by ndn::FlowClassifier
+   */
+  uint32_t GetNFlowPackets (uint64_t flowKey) const;
+
+protected:
+  virtual bool DoEnqueue (Ptr<Packet> p);
+  virtual Ptr<Packet> DoDequeue (void);
+  virtual Ptr<const Packet> DoPeek (void) const;
+
+  /**
+   * \brief Appends a flow which got its first packet to the active list
+   */
+  virtual void activate(uint32_t flowId);
+
+  /**
+   * \brief Removes the head packet of the first active flow
+   *
+   * Releases the flow if it runs empty and rotates the active list until the
+   * first flow can send its head packet again.
+   *
+   * \param charge Whether the packet is charged to the deficit of the flow
+   */
+  Ptr<Packet> popFirst(bool charge);
+
+  FlowTable m_flows;                  //!< dense ids of the traffic flows with queued packets
+  std::vector<FlowRing> m_queues;     //!< queues of all traffic flows, indexed by flow id
+  DeficitRoundRobin m_drr;            //!< deficit and active list link of every flow
+  DeficitRoundRobin::Round m_round;   //!< the active flows
+  std::array<uint32_t, ndn::FlowClassifier::QCI_BUCKETS> m_qciQuantum; //!< quantum per QCI class, 0 for the default
+  ndn::FlowClassifier m_classifier;  //!< maps packets to traffic flows
+  Ptr<SojournStats> m_sojournStats;   //!< sojourn times of the dequeued packets
+  std::string m_quanta;               //!< quanta as given to SetQuanta
+  uint32_t m_quantum;                 //!< default quantum in bytes
+  uint32_t m_maxPackets;              //!< max packets in the queue
+  uint32_t m_maxBytes;                //!< max bytes in the queue
+  uint32_t m_bytesInQueue;            //!< actual bytes in the queue
+  uint32_t m_packetsInQueue;          //!< actual packets in the queue
+  QueueMode m_mode;                   //!< queue mode (packets or bytes limited)
+};
+
+} // namespace ns3
+
+#endif /* DRRQUEUE_H */
@@ -0,0 +1,367 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2007 University of Washington
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/log.h"
+#include "ns3/enum.h"
+#include "ns3/uinteger.h"
+#include "ns3/boolean.h"
+#include "ns3/string.h"
+#include "ns3/pointer.h"
+#include "ns3/simulator.h"
+
+#include "ns3/ndnSIM/ndn-cxx/encoding/qci.hpp"
+
+#include <sstream>
+#include <stdexcept>
+
+#include "edf-queue.hpp"
+#include "class-list.hpp"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("EdfQueue");
+
+NS_OBJECT_ENSURE_REGISTERED (EdfQueue);
+
+namespace {
+
+/**
+ * \brief Sets the packet delay budgets of 3GPP TS 23.203, zero for the other classes
+ */
+void
+presetBudgets (std::array<Time, ndn::FlowClassifier::QCI_BUCKETS>& budget)
+{
+  budget.fill (Time ());
+  budget[ndn::QCI_1] = MilliSeconds (100);
+  budget[ndn::QCI_2] = MilliSeconds (150);
+  budget[ndn::QCI_3] = MilliSeconds (50);
+  budget[ndn::QCI_4] = MilliSeconds (300);
+  budget[ndn::QCI_5] = MilliSeconds (100);
+  budget[ndn::QCI_6] = MilliSeconds (300);
+  budget[ndn::QCI_7] = MilliSeconds (100);
+  budget[ndn::QCI_8] = MilliSeconds (300);
+  budget[ndn::QCI_9] = MilliSeconds (300);
+  budget[ndn::QCI_65] = MilliSeconds (75);
+  budget[ndn::QCI_66] = MilliSeconds (100);
+  budget[ndn::QCI_69] = MilliSeconds (60);
+  budget[ndn::QCI_70] = MilliSeconds (200);
+}
+
+} // namespace
+
+TypeId EdfQueue::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::EdfQueue")
+    .SetParent<Queue> ()
+    .SetGroupName("Network")
+    .AddConstructor<EdfQueue> ()
+    .AddAttribute ("Mode",
+                   "Whether to use bytes (see MaxBytes) or packets (see MaxPackets) as the maximum queue size metric.",
+                   EnumValue (QUEUE_MODE_PACKETS),
+                   MakeEnumAccessor (&EdfQueue::SetMode,
+                                     &EdfQueue::GetMode),
+                   MakeEnumChecker (QUEUE_MODE_BYTES, "QUEUE_MODE_BYTES",
+                                    QUEUE_MODE_PACKETS, "QUEUE_MODE_PACKETS"))
+    .AddAttribute ("MaxPackets",
+                   "The maximum number of packets accepted by this EdfQueue.",
+                   UintegerValue (100),
+                   MakeUintegerAccessor (&EdfQueue::m_maxPackets),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("MaxBytes",
+                   "The maximum number of bytes accepted by this EdfQueue.",
+                   UintegerValue (100 * 1024),
+                   MakeUintegerAccessor (&EdfQueue::m_maxBytes),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("DefaultBudget",
+                   "The packet delay budget of QCI classes without a 3GPP budget.",
+                   TimeValue (MilliSeconds (300)),
+                   MakeTimeAccessor (&EdfQueue::SetDefaultBudget,
+                                     &EdfQueue::GetDefaultBudget),
+                   MakeTimeChecker ())
+    .AddAttribute ("DelayBudgets",
+                   "Packet delay budgets of QCI classes, e.g. \"20=50ms 90=1s\", other classes keep their 3GPP budget or use DefaultBudget.",
+                   StringValue (""),
+                   MakeStringAccessor (&EdfQueue::SetDelayBudgets,
+                                       &EdfQueue::GetDelayBudgets),
+                   MakeStringChecker ())
+    .AddAttribute ("DropLate",
+                   "Whether packets which missed their deadline are dropped instead of dequeued.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&EdfQueue::m_dropLate),
+                   MakeBooleanChecker ())
+    .AddAttribute ("SojournStats",
+                   "The sojourn time histograms of the packets leaving this queue, per QCI class and traffic flow. Packets dropped by DropLate are not recorded.",
+                   TypeId::ATTR_GET,
+                   PointerValue (),
+                   MakePointerAccessor (&EdfQueue::m_sojournStats),
+                   MakePointerChecker<SojournStats> ())
+  ;
+
+  return tid;
+}
+
+EdfQueue::EdfQueue () :
+  Queue (),
+  m_dropLate (false),
+  m_bytesInQueue (0),
+  m_packetsInQueue (0)
+{
+  NS_LOG_FUNCTION (this);
+  m_sojournStats = CreateObject<SojournStats> ();
+
+  presetBudgets (m_budget);
+}
+
+EdfQueue::~EdfQueue ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+EdfQueue::SetMode (EdfQueue::QueueMode mode)
+{
+  NS_LOG_FUNCTION (this << mode);
+  m_mode = mode;
+}
+
+EdfQueue::QueueMode
+EdfQueue::GetMode (void) const
+{
+  NS_LOG_FUNCTION (this);
+  return m_mode;
+}
+
+void
+EdfQueue::SetDelayBudget (uint32_t qci, Time budget)
+{
+  NS_LOG_FUNCTION (this << qci << budget);
+  NS_ASSERT_MSG (qci < m_budget.size(), "QCI class out of range");
+  m_budget[qci] = budget;
+  updateDeadline(qci);
+}
+
+Time
+EdfQueue::GetDelayBudget (uint32_t qci) const
+{
+  if (qci < m_budget.size() && !m_budget[qci].IsZero()) {
+    return m_budget[qci];
+  }
+  return m_defaultBudget;
+}
+
+void
+EdfQueue::SetDelayBudgets (std::string budgets)
+{
+  NS_LOG_FUNCTION (this << budgets);
+
+  std::array<Time, ndn::FlowClassifier::QCI_BUCKETS> values;
+  presetBudgets (values);
+  for (const auto& entry : parseClassList(budgets)) {
+    std::istringstream value (entry.second);
+    Time budget;
+    value >> budget;
+    if (value.fail() || budget.IsStrictlyNegative()) {
+      throw std::invalid_argument("Delay budget `" + entry.second + "` is not a time");
+    }
+    values[entry.first] = budget;
+  }
+
+  m_budget = values;
+  for (uint32_t qci = 0; qci < m_classes.size(); qci++) {
+    updateDeadline(qci);
+  }
+  m_delayBudgets = budgets;
+}
+
+std::string
+EdfQueue::GetDelayBudgets (void) const
+{
+  return m_delayBudgets;
+}
+
+void
+EdfQueue::SetDefaultBudget (Time budget)
+{
+  NS_LOG_FUNCTION (this << budget);
+  m_defaultBudget = budget;
+  for (uint32_t qci = 0; qci < m_classes.size(); qci++) {
+    if (m_budget[qci].IsZero()) {
+      updateDeadline(qci);
+    }
+  }
+}
+
+Time
+EdfQueue::GetDefaultBudget (void) const
+{
+  return m_defaultBudget;
+}
+
+uint32_t
+EdfQueue::GetNQciPackets (uint32_t qci) const
+{
+  return qci < m_classes.size() ? m_classes[qci].size() : 0;
+}
+
+bool
+EdfQueue::DoEnqueue (Ptr<Packet> p)
+{
+  NS_LOG_FUNCTION (this << p);
+
+  ndn::FlowInfo info = m_classifier.classify(p);
+  uint32_t qci = info.qci;
+
+  if (m_mode == QUEUE_MODE_PACKETS && (m_packetsInQueue >= m_maxPackets))
+    {
+      NS_LOG_LOGIC ("Queue full (at max packets) -- droppping pkt");
+      Drop (p);
+      return false;
+    }
+
+  if (m_mode == QUEUE_MODE_BYTES && (m_bytesInQueue + p->GetSize () >= m_maxBytes))
+    {
+      NS_LOG_LOGIC ("Queue full (packet would exceed max bytes) -- droppping pkt");
+      Drop (p);
+      return false;
+    }
+
+  m_bytesInQueue += p->GetSize ();
+  m_packetsInQueue++;
+
+  FlowRing& queue = m_classes[qci];
+  queue.push_back(p, qci, info.flowKey, Simulator::Now());
+
+  // A class enters the schedule with its first packet, later packets have later deadlines
+  if (queue.size() == 1) {
+    m_schedule.push(qci, headDeadline(qci));
+  }
+
+  NS_LOG_LOGIC ("Deadline of packet " << Simulator::Now() + GetDelayBudget(qci));
+  NS_LOG_LOGIC ("Number packets " << m_packetsInQueue);
+  NS_LOG_LOGIC ("Number bytes " << m_bytesInQueue);
+
+  return true;
+}
+
+Ptr<Packet>
+EdfQueue::DoDequeue (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  while (m_packetsInQueue > 0)
+    {
+      uint32_t qci = m_schedule.top();
+
+      if (m_dropLate && headDeadline(qci) < Simulator::Now())
+        {
+          NS_LOG_LOGIC ("Deadline of QCI " << qci << " missed -- dropping pkt");
+          DropQueued (popHead(qci));
+          continue;
+        }
+
+      const FlowRing& queue = m_classes[qci];
+      m_sojournStats->Record(qci, queue.flowKey(0), Simulator::Now() - queue.enqueueTime(0));
+      Ptr<Packet> p = popHead(qci);
+
+      NS_LOG_LOGIC ("Popped " << p);
+
+      NS_LOG_LOGIC ("Number packets " << m_packetsInQueue);
+      NS_LOG_LOGIC ("Number bytes " << m_bytesInQueue);
+
+      return p;
+    }
+
+  NS_LOG_LOGIC ("Queue empty");
+  return 0;
+}
+
+Ptr<const Packet>
+EdfQueue::DoPeek (void) const
+{
+  NS_LOG_FUNCTION (this);
+
+  if (m_packetsInQueue == 0)
+    {
+      NS_LOG_LOGIC ("Queue empty");
+      return 0;
+    }
+
+  uint32_t qci = m_schedule.top();
+  Time now = Simulator::Now();
+  if (!m_dropLate || headDeadline(qci) >= now)
+    {
+      return m_classes[qci].packet(0);
+    }
+
+  // Dequeue drops the late packets before it returns one, they are at the
+  // head of their class, so the first packet in time of every class competes
+  Ptr<const Packet> p = 0;
+  Time earliest = Time::Max();
+  for (uint32_t c = 0; c < m_classes.size(); c++)
+    {
+      const FlowRing& queue = m_classes[c];
+      Time budget = GetDelayBudget(c);
+      for (uint32_t i = 0; i < queue.size(); i++)
+        {
+          Time deadline = queue.enqueueTime(i) + budget;
+          if (deadline >= now)
+            {
+              if (deadline < earliest)
+                {
+                  p = queue.packet(i);
+                  earliest = deadline;
+                }
+              break;
+            }
+        }
+    }
+  return p;
+}
+
+Time
+EdfQueue::headDeadline(uint32_t qci) const
+{
+  return m_classes[qci].enqueueTime(0) + GetDelayBudget(qci);
+}
+
+void
+EdfQueue::updateDeadline(uint32_t qci)
+{
+  if (!m_classes[qci].empty()) {
+    m_schedule.update(qci, headDeadline(qci));
+  }
+}
+
+Ptr<Packet>
+EdfQueue::popHead(uint32_t qci)
+{
+  FlowRing& queue = m_classes[qci];
+  Ptr<Packet> p = queue.pop_front();
+
+  if (queue.empty()) {
+    m_schedule.erase(qci);
+  } else {
+    m_schedule.update(qci, headDeadline(qci));
+  }
+
+  m_bytesInQueue -= p->GetSize ();
+  m_packetsInQueue--;
+  return p;
+}
+
+} // namespace ns3
@@ -0,0 +1,161 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2007 University of Washington
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef EDFQUEUE_H
+#define EDFQUEUE_H
+
+#include <array>
+#include <string>
+#include "ns3/packet.h"
+#include "ns3/queue.h"
+#include "ns3/nstime.h"
+
+#include "flow-classifier.hpp"
+#include "flow-ring.hpp"
+#include "indexed-heap.hpp"
+#include "sojourn-stats.hpp"
+
+namespace ns3 {
+
+/**
+ * \ingroup queue
+ *
+ * \brief An Earliest-Deadline-First packet queue with tail-drop drop policy.
+ *
+ * Every packet gets the deadline now + budget(QCI) on enqueue, where the
+ * budget is the packet delay budget of its QCI class. The packet with the
+ * earliest deadline is served first. Optionally, packets which already missed
+ * their deadline are dropped instead of being sent.
+ *
+ * Since the budget is fixed per class, the deadlines within a class are in
+ * arrival order. The queue therefore keeps one FIFO per QCI class and an
+ * indexed heap of the classes keyed by the deadline of their head packet,
+ * which costs O(log classes) per packet.
+ */
+class EdfQueue : public Queue {
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+  /**
+   * \brief EdfQueue Constructor
+   *
+   * Creates an EDF queue with a maximum size of 100 packets by default
+   */
+  EdfQueue ();
+
+  virtual ~EdfQueue();
+
+  /**
+   * Set the operating mode of this device.
+   *
+   * \param mode The operating mode of this device.
+   *
+   */
+  void SetMode (EdfQueue::QueueMode mode);
+
+  /**
+   * Get the encapsulation mode of this device.
+   *
+   * \returns The encapsulation mode of this device.
+   */
+  EdfQueue::QueueMode GetMode (void) const;
+
+  /**
+   * \brief Sets the packet delay budget of the given QCI class
+   *
+   * Queued packets of the class take the new budget as well. The 3GPP
+   * budgets are preset for the classes of ndn::QCI_CLASSES, the other
+   * classes use the DefaultBudget attribute.
+   *
+   * \param qci The QCI class
+   * \param budget The packet delay budget, zero restores the default budget
+   */
+  void SetDelayBudget (uint32_t qci, Time budget);
+
+  /**
+   * \return The packet delay budget of the given QCI class
+   */
+  Time GetDelayBudget (uint32_t qci) const;
+
+  /**
+   * \brief Sets the packet delay budgets of the QCI classes from a list
+   *
+   * \param budgets List of `qci=time` entries separated by whitespace, `,`
+   * or `;`. Classes which are not listed get their 3GPP budget, if any.
+   *
+   * \throw std::invalid_argument if an entry cannot be parsed
+   */
+  void SetDelayBudgets (std::string budgets);
+
+  std::string GetDelayBudgets (void) const;
+
+  /**
+   * \brief Sets the packet delay budget of the classes without an own budget
+   *
+   * Queued packets of these classes take the new budget as well.
+   */
+  void SetDefaultBudget (Time budget);
+
+  Time GetDefaultBudget (void) const;
+
+  /**
+   * \return The number of packets of the given QCI class in the queue
+   */
+  uint32_t GetNQciPackets (uint32_t qci) const;
+
+protected:
+  virtual bool DoEnqueue (Ptr<Packet> p);
+  virtual Ptr<Packet> DoDequeue (void);
+  virtual Ptr<const Packet> DoPeek (void) const;
+
+  /**
+   * \brief Returns the deadline of the head packet of the given class
+   */
+  Time headDeadline(uint32_t qci) const;
+
+  /**
+   * \brief Moves a class in the schedule after its budget changed
+   */
+  void updateDeadline(uint32_t qci);
+
+  /**
+   * \brief Removes and returns the head packet of the given class
+   */
+  Ptr<Packet> popHead(uint32_t qci);
+
+  std::array<FlowRing, ndn::FlowClassifier::QCI_BUCKETS> m_classes; //!< packets of every QCI class in arrival order
+  std::array<Time, ndn::FlowClassifier::QCI_BUCKETS> m_budget;      //!< delay budget per QCI class, zero for the default
+  IndexedHeap<Time> m_schedule;       //!< non-empty classes ordered by the deadline of their head packet
+  ndn::FlowClassifier m_classifier;  //!< extracts the QCI class of packets
+  Ptr<SojournStats> m_sojournStats;   //!< sojourn times of the dequeued packets
+  std::string m_delayBudgets;         //!< budgets as given to SetDelayBudgets
+  Time m_defaultBudget;               //!< delay budget of classes without an own budget
+  bool m_dropLate;                    //!< drop packets which missed their deadline
+  uint32_t m_maxPackets;              //!< max packets in the queue
+  uint32_t m_maxBytes;                //!< max bytes in the queue
+  uint32_t m_bytesInQueue;            //!< actual bytes in the queue
+  uint32_t m_packetsInQueue;          //!< actual packets in the queue
+  QueueMode m_mode;                   //!< queue mode (packets or bytes limited)
+};
+
+} // namespace ns3
+
+#endif /* EDFQUEUE_H */
@@ -19,15 +19,11 @@
 #include "ns3/log.h"
 #include "ns3/enum.h"
 #include "ns3/uinteger.h"
-#include "ns3/ppp-header.h"
-#include "ns3/ndnSIM/model/ndn-ns3.hpp"
+#include "ns3/string.h"
+#include "ns3/boolean.h"
+#include "ns3/pointer.h"
 #include "ns3/simulator.h"
 
-#include "utils/ndn-ns3-packet-tag.hpp"
-
-#include <ndn-cxx/encoding/block.hpp>
-#include <ndn-cxx/interest.hpp>
-#include <ndn-cxx/data.hpp>
 #include "fair-queue.hpp"
 #include "tags/ndn-queue-virtual-finish-time-tag.hpp"
 
@@ -60,6 +56,50 @@ TypeId FairQueue::GetTypeId (void)
                    UintegerValue (100 * 1024),
                    MakeUintegerAccessor (&FairQueue::m_maxBytes),
                    MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("FinishTimeTag",
+                   "Whether queued packets carry a VirtualFinishTimeTag for external observers.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&FairQueue::m_finishTimeTag),
+                   MakeBooleanChecker ())
+    .AddAttribute ("Buckets",
+                   "The number of hash buckets for stochastic fair queuing, 0 keeps every traffic flow in its own queue.",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&FairQueue::m_buckets),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("PerturbInterval",
+                   "The time after which the hash of the buckets is changed (stochastic fair queuing).",
+                   TimeValue (Seconds (10)),
+                   MakeTimeAccessor (&FairQueue::m_perturbInterval),
+                   MakeTimeChecker ())
+    .AddAttribute ("Classifier",
+                   "Rules for separating traffic flows by name prefix, e.g. \"/=2 /video=4\" (see ndn::FlowClassifier::setRules).",
+                   StringValue (""),
+                   MakeStringAccessor (&FairQueue::SetClassifier,
+                                       &FairQueue::GetClassifier),
+                   MakeStringChecker ())
+    .AddAttribute ("FreshestQcis",
+                   "Real-time QCI classes whose flows drop their oldest packet instead of an arriving one on overflow, e.g. \"1 3\".",
+                   StringValue (""),
+                   MakeStringAccessor (&FairQueue::SetFreshestQcis,
+                                       &FairQueue::GetFreshestQcis),
+                   MakeStringChecker ())
+    .AddAttribute ("FreshestMaxPackets",
+                   "The maximum number of packets queued per flow of a FreshestQcis class, 0 for no limit.",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&FairQueue::m_freshestMaxPackets),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("SojournStats",
+                   "The sojourn time histograms of the packets leaving this queue, per QCI class and traffic flow.",
+                   TypeId::ATTR_GET,
+                   PointerValue (),
+                   MakePointerAccessor (&FairQueue::m_sojournStats),
+                   MakePointerChecker<SojournStats> ())
+    .AddAttribute ("BufferPartition",
+                   "The per-QCI buffer shares of this queue and the trace of its drops per class.",
+                   TypeId::ATTR_GET,
+                   PointerValue (),
+                   MakePointerAccessor (&FairQueue::m_bufferPartition),
+                   MakePointerChecker<BufferPartition> ())
   ;
 
   return tid;
@@ -67,10 +107,18 @@ TypeId FairQueue::GetTypeId (void)
 
 FairQueue::FairQueue () :
   Queue (),
-  m_packets (),
-  m_bytesInQueue (0)
+  m_bytesInQueue (0),
+  m_packetsInQueue (0),
+  m_qciPackets (),
+  m_qciBytes (),
+  m_finishTimeTag (false),
+  m_freshestMaxPackets (0),
+  m_buckets (0),
+  m_perturbation (0)
 {
   NS_LOG_FUNCTION (this); 
+  m_sojournStats = CreateObject<SojournStats> ();
+  m_bufferPartition = CreateObject<BufferPartition> ();
 }
 
 FairQueue::~FairQueue ()
@@ -82,6 +130,7 @@ void
 FairQueue::SetMode (FairQueue::QueueMode mode)
 {
   NS_LOG_FUNCTION (this << mode);
+  NS_ASSERT_MSG (m_packetsInQueue == 0, "Mode cannot change while packets are queued");
   m_mode = mode;
 }
 
@@ -92,89 +141,163 @@ FairQueue::GetMode (void) const
   return m_mode;
 }
 
+void
+FairQueue::SetClassifier (std::string rules)
+{
+  NS_LOG_FUNCTION (this << rules);
+  m_classifier.setRules(rules);
+}
+
+std::string
+FairQueue::GetClassifier (void) const
+{
+  return m_classifier.getRules();
+}
+
+void
+FairQueue::SetFreshestQcis (std::string qcis)
+{
+  NS_LOG_FUNCTION (this << qcis);
+  m_freshestQcis.parse(qcis);
+}
+
+std::string
+FairQueue::GetFreshestQcis (void) const
+{
+  return m_freshestQcis.str();
+}
+
+uint32_t
+FairQueue::GetNFlows (void) const
+{
+  return m_mode == QUEUE_MODE_PACKETS ? m_activeFlows.size() : m_schedule.size();
+}
+
+uint32_t
+FairQueue::GetNFlowPackets (uint64_t flowKey) const
+{
+  uint32_t flowId = findFlow(flowKey);
+  if (flowId == FlowTable::INVALID_FLOW) {
+    return 0;
+  }
+  if (m_buckets == 0) {
+    return m_queues[flowId].size();
+  }
+
+  // Flows share hash buckets, so count the packets of this flow only
+  const FlowRing& queue = m_queues[flowId];
+  uint32_t packets = 0;
+  for (uint32_t i = 0; i < queue.size(); i++) {
+    if (queue.flowKey(i) == flowKey) {
+      packets++;
+    }
+  }
+  return packets;
+}
+
+uint32_t
+FairQueue::GetNQciPackets (uint32_t qci) const
+{
+  return qci < m_qciPackets.size() ? m_qciPackets[qci] : 0;
+}
+
+uint32_t
+FairQueue::GetNQciBytes (uint32_t qci) const
+{
+  return qci < m_qciBytes.size() ? m_qciBytes[qci] : 0;
+}
+
 bool 
 FairQueue::DoEnqueue (Ptr<Packet> p)
 {
   NS_LOG_FUNCTION (this << p);
 
-  Ptr<Packet> packet = p->Copy();
-
-  PppHeader ppp;
-  packet->RemoveHeader(ppp);
-
-  std::string name = ""; 
-
-  // Convert packet to Interest or Data and fetch the name
-  try {
-    switch (ndn::Convert::getPacketType(packet)) {
-      case ::ndn::tlv::Interest: {
-        std::shared_ptr<const ::ndn::Interest> i = ndn::Convert::FromPacket<::ndn::Interest>(packet);
-        ::ndn::Name prefix = i->getName();
-        prefix = prefix.getPrefix(2); 
-        name = prefix.toUri();
-        break;
-      }
-      case ::ndn::tlv::Data: {
-        std::shared_ptr<const ::ndn::Data> d = ndn::Convert::FromPacket<::ndn::Data>(packet);
-        ::ndn::Name prefix = d->getName();
-        prefix = prefix.getPrefix(2); 
-        name = prefix.toUri();
-        break;
-      }
-      // case ::ndn::tlv::Nack: {
-      //   shared_ptr<const Nack> n = Convert::FromPacket<Nack>(packet);
-      //   this->onReceiveNack(*n);
-      // }
-      default:
-        NS_LOG_ERROR("Unsupported TLV packet");
-    }
-  }
-  catch (const ::ndn::tlv::Error& e) {
-    NS_LOG_ERROR("Unrecognized TLV packet " << e.what());
-  }
+  ndn::FlowInfo info = m_classifier.classify(p);
+  uint64_t flowKey = info.flowKey;
 
-  NS_LOG_DEBUG("Queuing packet with name: " << name);
+  NS_LOG_DEBUG("Queuing packet of flow " << flowKey);
 
   //NS_LOG_FUNCTION()
 
-  if (m_mode == QUEUE_MODE_PACKETS && (countPackets() >= m_maxPackets))
+  // Real-time classes make room by dropping the oldest packets of their own flow
+  uint32_t staleId = FlowTable::INVALID_FLOW;
+  uint32_t stale = 0;
+  uint32_t staleBytes = 0;
+  if (m_freshestQcis.contains(info.qci)) {
+    staleId = findFlow(flowKey);
+    stale = countStale(staleId, flowKey, p->GetSize (), staleBytes);
+  }
+
+  // Classes beyond their buffer share are dropped before they crowd out
+  // others, the share counts the stale packets as gone
+  m_bufferPartition->SetLimit(m_mode == QUEUE_MODE_PACKETS ? m_maxPackets : m_maxBytes, m_mode == QUEUE_MODE_BYTES);
+  if (!m_bufferPartition->Admit(info.qci, p->GetSize (), stale, staleBytes))
+    {
+      NS_LOG_LOGIC ("Buffer share of QCI " << info.qci << " exhausted -- droppping pkt");
+      m_bufferPartition->NotifyDrop (p, info.qci);
+      Drop (p);
+      return false;
+    }
+
+  if (stale == 0 && m_mode == QUEUE_MODE_PACKETS && (countPackets() >= m_maxPackets))
     {
       NS_LOG_LOGIC ("Queue full (at max packets) -- droppping pkt");
+      m_bufferPartition->NotifyDrop (p, info.qci);
       Drop (p);
       return false;
     }
 
-  if (m_mode == QUEUE_MODE_BYTES && (m_bytesInQueue + p->GetSize () >= m_maxBytes))
+  if (stale == 0 && m_mode == QUEUE_MODE_BYTES && (m_bytesInQueue + p->GetSize () >= m_maxBytes))
     {
       NS_LOG_LOGIC ("Queue full (packet would exceed max bytes) -- droppping pkt");
+      m_bufferPartition->NotifyDrop (p, info.qci);
       Drop (p);
       return false;
     }
 
-  m_bytesInQueue += p->GetSize ();
+  for (; stale > 0; stale--)
+    {
+      NS_LOG_LOGIC ("Fresher pkt arrived -- dropping head pkt of flow " << flowKey);
+      dropHead (staleId);
+    }
 
-  // Check if name is already in queue
-  if (!hasName(name)) {
-    // Create new queue
-    std::pair<std::string, std::deque<Ptr<Packet>>> pair (name, std::deque<Ptr<Packet>>());
-    m_queues.insert(pair);
-    // Create new VirtualFinishTime-Entry
-    std::pair<std::string, uint32_t> finishPair (name, 0);
-    m_virtualFinish.insert(finishPair);
-    // Store name of queue
-    m_queue_names.insert(m_queue_names.end(), name);
+  m_bytesInQueue += p->GetSize ();
+  m_packetsInQueue++;
+  m_qciPackets[info.qci]++;
+  m_qciBytes[info.qci] += p->GetSize ();
+  m_bufferPartition->Add(info.qci, p->GetSize ());
+
+  // Look up the flow, flows without queued packets get a new id
+  bool isNew = false;
+  uint32_t flowId = lookupFlow(flowKey, isNew);
+  if (flowId >= m_queues.size()) {
+    m_queues.resize(flowId + 1);
+    m_virtualFinish.resize(flowId + 1);
+  }
+  if (isNew) {
+    // The new flow may be served before the selected one
+    m_selected = FlowTable::INVALID_FLOW;
+    m_virtualFinish[flowId] = 0;
+    // New flows wait for their turn behind the active flows
+    if (m_mode == QUEUE_MODE_PACKETS) {
+      m_activeFlows.push_back(flowId);
+    }
   }
   // Add packet to queue
-  auto res = m_queues.find(name);
-  res->second.push_back(p);
+  FlowRing& queue = m_queues[flowId];
+  queue.push_back(p, info.qci, flowKey, Simulator::Now());
   
   // update virtual finishing time of the queue
-  updateTime(p, name);
+  VirtualTime virFinish = updateTime(flowId);
 
+  // A flow enters the schedule with its first packet, later packets queue behind it
+  if (m_mode == QUEUE_MODE_BYTES && queue.size() == 1) {
+    m_schedule.push(flowId, virFinish);
+  }
 
   NS_LOG_LOGIC ("Number packets " << countPackets());
   NS_LOG_LOGIC ("Number bytes " << m_bytesInQueue);
-  NS_LOG_LOGIC ("Number of queues " << m_queue_names.size());
+  NS_LOG_LOGIC ("Number of queues " << GetNFlows());
 
   return true;
 }
@@ -190,42 +313,50 @@ FairQueue::DoDequeue (void)
     return 0;
   }
 
-  if (m_queue_names.size() == 0) {
-    m_currentQueue = 0;
-  } else {
-    if (m_mode == QUEUE_MODE_PACKETS) {
-      m_currentQueue = (m_currentQueue + 1) % (m_queue_names.size());
-    } else if (m_mode == QUEUE_MODE_BYTES) {
-      
-      m_currentQueue = selectQueue();
+  uint32_t flowId = selectQueue();
+  m_selected = FlowTable::INVALID_FLOW;
 
+  NS_LOG_LOGIC("Dequeu Packet from Queue " << flowId);
+  
+  FlowRing& queue = m_queues[flowId];
+  uint32_t qci = queue.qci(0);
+  m_sojournStats->Record(qci, queue.flowKey(0), Simulator::Now() - queue.enqueueTime(0));
+  Ptr<Packet> p = queue.pop_front();
+
+  if (queue.empty()) {
+    NS_LOG_LOGIC("Erase queue " << flowId);
+    if (m_buckets == 0) {
+      m_flows.release(flowId);
     }
+    if (m_mode == QUEUE_MODE_PACKETS) {
+      m_activeFlows.erase(flowId);
+    } else {
+      m_schedule.pop();
+    }
+  } else if (m_mode == QUEUE_MODE_BYTES) {
+    // The next packet of the flow is now at the head
+    m_schedule.update(flowId, queue.virtualFinish(0));
+  } else {
+    // The flow gets its next turn after all other active flows
+    m_activeFlows.advance();
   }
 
-  std::string name = m_queue_names.at(m_currentQueue);
-  NS_LOG_LOGIC("Dequeu Packet from Queue " << name);
-  
-  auto res = m_queues.find(name);
-  Ptr<Packet> p = res->second.front();
-  res->second.pop_front();
-
-  if (res->second.size() == 0) {
-    NS_LOG_LOGIC("Erase queue for name " << name);
-    m_queues.erase(name);
-    m_virtualFinish.erase(name);
-    m_queue_names.erase(m_queue_names.begin() + m_currentQueue);
+  if (m_finishTimeTag) {
+    ndn::VirtualFinishTimeTag tag;
+    p->RemovePacketTag(tag);
   }
 
-  ndn::VirtualFinishTimeTag tag;
-  p->RemovePacketTag(tag);
-
   m_bytesInQueue -= p->GetSize ();
+  m_packetsInQueue--;
+  m_qciPackets[qci]--;
+  m_qciBytes[qci] -= p->GetSize ();
+  m_bufferPartition->Remove(qci, p->GetSize ());
 
   NS_LOG_LOGIC ("Popped " << p);
 
   NS_LOG_LOGIC ("Number packets " << countPackets());
   NS_LOG_LOGIC ("Number bytes " << m_bytesInQueue);
-  NS_LOG_LOGIC ("Number of queues " << m_queue_names.size());
+  NS_LOG_LOGIC ("Number of queues " << GetNFlows());
 
   return p;
 }
@@ -235,93 +366,190 @@ FairQueue::DoPeek (void) const
 {
   NS_LOG_FUNCTION (this);
 
-  if (m_packets.empty ())
+  if (countPackets() == 0)
     {
       NS_LOG_LOGIC ("Queue empty");
       return 0;
     }
 
-  auto currentQueue = m_currentQueue;
-  if (m_queue_names.size() == 0) {
-    currentQueue = 0;
-  } else {
-    if (m_mode == QUEUE_MODE_PACKETS) {
-      currentQueue = (currentQueue + 1) % (m_queue_names.size());
-    } else if (m_mode == QUEUE_MODE_BYTES) {
-      
-      currentQueue = selectQueue();
-
-    }
-  }
-
-  std::string name = m_queue_names.at(currentQueue);
-  NS_LOG_LOGIC("Peek Packet from Queue " << name);
+  uint32_t flowId = selectQueue();
+  NS_LOG_LOGIC("Peek Packet from Queue " << flowId);
   
-  auto res = m_queues.find(name);
-  Ptr<Packet> p = res->second.front();
+  Ptr<Packet> p = m_queues[flowId].packet(0);
 
   NS_LOG_LOGIC ("Number packets " << countPackets());
   NS_LOG_LOGIC ("Number bytes " << m_bytesInQueue);
-  NS_LOG_LOGIC ("Number of queues " << m_queue_names.size());
+  NS_LOG_LOGIC ("Number of queues " << GetNFlows());
 
   return p;
 }
 
-uint
-FairQueue::countPackets(void) const
+bool
+FairQueue::isFull(uint32_t packets, uint32_t bytes, uint32_t size) const
 {
-  int size = 0;
-  for (auto it = m_queues.begin(); it != m_queues.end(); ++it) {
-    size += it->second.size();
+  if (m_mode == QUEUE_MODE_PACKETS) {
+    return packets >= m_maxPackets;
   }
-  return size;
+  return bytes + size >= m_maxBytes;
 }
 
-bool
-FairQueue::hasName(std::string name) const
+uint32_t
+FairQueue::countStale(uint32_t flowId, uint64_t flowKey, uint32_t size, uint32_t& staleBytes) const
 {
-  auto result = m_queues.find(name);
-  if (result == m_queues.end()) {
-    return false;
+  if (flowId == FlowTable::INVALID_FLOW) {
+    return 0;
   }
-  return true;
+
+  const FlowRing& queue = m_queues[flowId];
+  uint32_t packets = m_packetsInQueue;
+  uint32_t bytes = m_bytesInQueue;
+  uint32_t stale = 0;
+  while (stale < queue.size() && queue.flowKey(stale) == flowKey &&
+         (isFull(packets, bytes, size) ||
+          (m_freshestMaxPackets > 0 && queue.size() - stale >= m_freshestMaxPackets))) {
+    packets--;
+    bytes -= queue.bytes(stale);
+    stale++;
+  }
+  if (isFull(packets, bytes, size)) {
+    return 0;
+  }
+  staleBytes = m_bytesInQueue - bytes;
+  return stale;
 }
 
 void
-FairQueue::updateTime(Ptr<const Packet> packet, std::string queueName)
+FairQueue::dropHead(uint32_t flowId)
 {
-  double finishRes = m_virtualFinish.find(queueName)->second;
-  uint64_t now = Now().GetMilliSeconds();
-  double virStart = (finishRes < now ? now : finishRes);
-  ndn::VirtualFinishTimeTag tag;
-  double virFinish = virStart + packet->GetSize();
-  tag.setVirtualFinishTime(virFinish);
-  packet->AddPacketTag(tag);
-  m_virtualFinish.find(queueName)->second = virFinish;
+  FlowRing& queue = m_queues[flowId];
+  uint32_t qci = queue.qci(0);
+  Ptr<Packet> p = queue.pop_front();
+  m_selected = FlowTable::INVALID_FLOW;
+
+  if (queue.empty()) {
+    NS_LOG_LOGIC("Erase queue " << flowId);
+    if (m_buckets == 0) {
+      m_flows.release(flowId);
+    }
+    if (m_mode == QUEUE_MODE_PACKETS) {
+      m_activeFlows.erase(flowId);
+    } else {
+      m_schedule.erase(flowId);
+    }
+  } else if (m_mode == QUEUE_MODE_BYTES) {
+    // The next packet of the flow is now at the head
+    m_schedule.update(flowId, queue.virtualFinish(0));
+  }
+
+  if (m_finishTimeTag) {
+    ndn::VirtualFinishTimeTag tag;
+    p->RemovePacketTag(tag);
+  }
+
+  m_bytesInQueue -= p->GetSize ();
+  m_packetsInQueue--;
+  m_qciPackets[qci]--;
+  m_qciBytes[qci] -= p->GetSize ();
+  m_bufferPartition->Remove(qci, p->GetSize ());
+  m_bufferPartition->NotifyDrop (p, qci);
+
+  DropQueued (p);
+}
+
+uint32_t
+FairQueue::findFlow(uint64_t flowKey) const
+{
+  if (m_buckets == 0) {
+    return m_flows.find(flowKey);
+  }
+
+  uint32_t bucket = hashBucket(flowKey);
+  if (bucket >= m_queues.size() || m_queues[bucket].empty()) {
+    return FlowTable::INVALID_FLOW;
+  }
+  return bucket;
+}
+
+uint32_t
+FairQueue::lookupFlow(uint64_t flowKey, bool& isNew)
+{
+  if (m_buckets == 0) {
+    return m_flows.intern(flowKey, isNew);
+  }
+
+  // Stochastic fair queuing, all buckets are allocated up front
+  if (m_queues.size() < m_buckets) {
+    m_queues.resize(m_buckets);
+    m_virtualFinish.resize(m_buckets);
+    m_activeFlows.reserve(m_buckets);
+  }
+
+  // Change the hash from time to time, so colliding flows get separated again
+  Time now = Simulator::Now();
+  if (now >= m_nextPerturbation) {
+    m_perturbation = mixKey(m_perturbation + 0x9e3779b97f4a7c15ULL);
+    m_nextPerturbation = now + m_perturbInterval;
+    NS_LOG_LOGIC("New bucket perturbation " << m_perturbation);
+  }
+
+  uint32_t bucket = hashBucket(flowKey);
+  isNew = m_queues[bucket].empty();
+  return bucket;
+}
+
+uint32_t
+FairQueue::hashBucket(uint64_t flowKey) const
+{
+  return mixKey(flowKey ^ m_perturbation) % m_buckets;
+}
+
+uint64_t
+FairQueue::mixKey(uint64_t key)
+{
+  // Finalizer of splitmix64
+  key = (key ^ (key >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  key = (key ^ (key >> 27)) * 0x94d049bb133111ebULL;
+  return key ^ (key >> 31);
 }
 
 uint
+FairQueue::countPackets(void) const
+{
+  return m_packetsInQueue;
+}
+
+VirtualTime
+FairQueue::updateTime(uint32_t flowId)
+{
+  FlowRing& queue = m_queues[flowId];
+  VirtualTime finishRes = m_virtualFinish[flowId];
+  VirtualTime now = toVirtualTime(Now());
+  VirtualTime virStart = (finishRes < now ? now : finishRes);
+  uint32_t tail = queue.size() - 1;
+  VirtualTime virFinish = virStart + queue.bytes(tail) * VIRTUAL_TIME_PER_BYTE;
+  queue.virtualStart(tail) = virStart;
+  queue.virtualFinish(tail) = virFinish;
+  if (m_finishTimeTag) {
+    ndn::VirtualFinishTimeTag tag;
+    tag.setVirtualFinishTime(virFinish);
+    queue.packet(tail)->AddPacketTag(tag);
+  }
+  m_virtualFinish[flowId] = virFinish;
+  return virFinish;
+}
+
+uint32_t
 FairQueue::selectQueue() const
 {
-  uint selectedQueue = 0;
-  int i = 0;
-  double minVirFinish = std::numeric_limits<double>::max();
-  for (auto it = m_queue_names.begin(); it != m_queue_names.end(); ++it) {
-    auto queue = m_queues.find(*it)->second;
-    if (queue.size() > 0) {
-      auto packet = queue.front();
-      ndn::VirtualFinishTimeTag tag;
-      packet->RemovePacketTag(tag);
-      double virFinish = tag.getVirtualFinishTime();
-      if (virFinish < minVirFinish) {
-        minVirFinish = virFinish;
-        selectedQueue = i;
-      }
-      packet->AddPacketTag(tag);
-    }
-    i++;
+  if (m_selected != FlowTable::INVALID_FLOW) {
+    return m_selected;
+  }
+  if (m_mode == QUEUE_MODE_BYTES) {
+    m_selected = m_schedule.top();
+  } else {
+    m_selected = m_activeFlows.front();
   }
-  return selectedQueue;
+  return m_selected;
 }
 
 } // namespace ns3
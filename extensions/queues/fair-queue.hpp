@@ -19,10 +19,21 @@
 #ifndef FAIRQUEUE_H
 #define FAIRQUEUE_H
 
-#include <queue>
-#include <unordered_map>
+#include <array>
+#include <vector>
+#include <string>
 #include "ns3/packet.h"
 #include "ns3/queue.h"
+#include "ns3/nstime.h"
+
+#include "buffer-partition.hpp"
+#include "flow-classifier.hpp"
+#include "flow-list.hpp"
+#include "flow-ring.hpp"
+#include "flow-table.hpp"
+#include "indexed-heap.hpp"
+#include "qci-set.hpp"
+#include "sojourn-stats.hpp"
 
 namespace ns3 {
 
@@ -35,7 +46,28 @@ namespace ns3 {
  * that some traffic flows produces more packets than others. Fair queuing allows
  * the same amount of packets for all traffic flows.
  *
- * To separate traffic flows in NDN the first two parts of the names are used.
+ * To separate traffic flows in NDN the first two parts of the names are used,
+ * other prefix lengths can be configured with the Classifier attribute.
+ *
+ * With the Buckets attribute set, the queue runs Stochastic Fair Queuing
+ * (SFQ): flows are hashed into a fixed number of queues instead of getting
+ * their own, so memory stays constant however many prefixes cross the link,
+ * and enqueue and dequeue do not allocate once the buckets reached their
+ * largest size. Colliding flows share a bucket until the hash is changed,
+ * every PerturbInterval. Packets queued before a change stay in their bucket,
+ * so a flow may be reordered at that moment.
+ *
+ * For real-time classes listed in FreshestQcis (e.g. voice or gaming push
+ * streams) an old packet is worthless once a newer one of the same flow
+ * arrives. When the queue is full, an arriving packet of such a class drops
+ * the oldest queued packets of its flow (head drop) instead of being dropped
+ * itself. FreshestMaxPackets additionally caps each of these flows. With
+ * Buckets, the head packets of the flow's bucket are dropped as long as they
+ * belong to the flow, and the cap counts the whole bucket.
+ *
+ * The BufferPartition object splits MaxPackets or MaxBytes into per-QCI
+ * shares, see its Shares attribute. Its Drop trace reports every drop of the
+ * queue with the class of the packet.
  */
 class FairQueue : public Queue {
 public:
@@ -56,6 +88,9 @@ public:
   /**
    * Set the operating mode of this device.
    *
+   * The mode also selects the scheduler (round robin for packets, virtual
+   * finishing time for bytes) and must not change while packets are queued.
+   *
    * \param mode The operating mode of this device.
    *
    */
@@ -68,6 +103,46 @@ public:
    */
   FairQueue::QueueMode GetMode (void) const;
 
+  /**
+   * \brief Sets the rules which separate traffic flows by name prefix
+   *
+   * \param rules Rules as accepted by ndn::FlowClassifier::setRules
+   */
+  void SetClassifier (std::string rules);
+
+  std::string GetClassifier (void) const;
+
+  /**
+   * \brief Sets the real-time QCI classes whose flows keep their freshest packets
+   *
+   * \param qcis List of QCI values as accepted by QciSet::parse
+   */
+  void SetFreshestQcis (std::string qcis);
+
+  std::string GetFreshestQcis (void) const;
+
+  /**
+   * \return The number of traffic flows that currently have packets in the queue
+   */
+  uint32_t GetNFlows (void) const;
+
+  /**
+   * \return The number of packets of the given traffic flow in the queue
+   *
+   * \param flowKey Flow key as computed by ndn::FlowClassifier
+   */
+  uint32_t GetNFlowPackets (uint64_t flowKey) const;
+
+  /**
+   * \return The number of packets of the given QCI class in the queue
+   */
+  uint32_t GetNQciPackets (uint32_t qci) const;
+
+  /**
+   * \return The number of bytes of the given QCI class in the queue
+   */
+  uint32_t GetNQciBytes (uint32_t qci) const;
+
 protected:
   virtual bool DoEnqueue (Ptr<Packet> p);
   virtual Ptr<Packet> DoDequeue (void);
@@ -79,33 +154,96 @@ protected:
   uint countPackets(void) const; 
 
   /**
-   * \brief Checks if queue for the given name exists
+   * \brief Updates virtual finishing time
+   * 
+   * Calculates the virtual start and finishing time of the packet at the tail of the given flow's queue
+   *
+   * \return The virtual finishing time of the packet
+   */
+  VirtualTime updateTime(uint32_t flowId);
+
+  /**
+   * \brief Select the next queue to dequeu
    *
-   * @param name Name to query
+   * The selection is kept until the schedule changes, so a Peek followed
+   * by a Dequeue selects only once.
+   *
+   * \return The flow id of the selected queue
    */
-  bool hasName(std::string name) const;
+  uint32_t selectQueue() const;
 
   /**
-   * \brief Updates virtual finishing time
-   * 
-   * Calculates the new virtual finishing time for the given queue considering the given packet
+   * \brief Whether a packet of the given size exceeds the queue limit
    */
-  void updateTime(Ptr<const Packet> packet, std::string queueName);
+  bool isFull(uint32_t packets, uint32_t bytes, uint32_t size) const;
 
   /**
-   * \brief Select the next queue to dequeu
+   * \brief Returns the number of head packets to drop for an arriving packet of a FreshestQcis class
+   *
+   * Head packets of the flow are dropped while the queue is full or the
+   * flow's queue holds FreshestMaxPackets. If dropping all of them does not
+   * make room, none is dropped and 0 is returned, the arriving packet is
+   * dropped then.
+   *
+   * \param flowId Queue of the flow, INVALID_FLOW if the flow has no packets
+   * \param[out] staleBytes Bytes of the packets to drop
+   */
+  uint32_t countStale(uint32_t flowId, uint64_t flowKey, uint32_t size, uint32_t& staleBytes) const;
+
+  /**
+   * \brief Removes and drops the head packet of the given queue
+   */
+  void dropHead(uint32_t flowId);
+
+  /**
+   * \brief Returns the queue of the given flow without adding it, INVALID_FLOW if it has none
+   */
+  uint32_t findFlow(uint64_t flowKey) const;
+
+  /**
+   * \brief Returns the queue of the given flow
+   *
+   * With stochastic fair queuing, this is the bucket the flow hashes to,
+   * otherwise the dense id of the flow.
+   *
+   * \param flowKey Flow key as computed by ndn::FlowClassifier
+   * \param isNew Set to true if the queue has no packets yet
+   */
+  uint32_t lookupFlow(uint64_t flowKey, bool& isNew);
+
+  /**
+   * \brief Returns the bucket of a flow key under the current perturbation
+   */
+  uint32_t hashBucket(uint64_t flowKey) const;
+
+  /**
+   * \brief Mixes the bits of a key
    */
-  uint selectQueue() const;
+  static uint64_t mixKey(uint64_t key);
 
-  std::queue<Ptr<Packet> > m_packets; //!< the packets in the queue
-  std::unordered_map<std::string, std::deque<Ptr<Packet>>> m_queues; //!< map containing queues for all traffic flows
-  std::vector<std::string> m_queue_names; //!< Names of the queues
-  std::unordered_map<std::string, double> m_virtualFinish; //!< Virtual finishing times for all queues
-  uint32_t m_currentQueue = 0;
+  FlowTable m_flows;                  //!< dense ids of the traffic flows with queued packets
+  std::vector<FlowRing> m_queues;     //!< queues of all traffic flows, indexed by flow id
+  std::vector<VirtualTime> m_virtualFinish; //!< virtual finishing time of the last packet, indexed by flow id
+  FlowList m_activeFlows;             //!< flows with queued packets in round robin order (packet mode)
+  IndexedHeap<VirtualTime> m_schedule; //!< flows ordered by virtual finishing time of their head packet (byte mode)
+  ndn::FlowClassifier m_classifier;  //!< maps packets to traffic flows
+  Ptr<SojournStats> m_sojournStats;   //!< sojourn times of the dequeued packets
+  Ptr<BufferPartition> m_bufferPartition; //!< per-QCI buffer shares and class drop trace
+  mutable uint32_t m_selected = FlowTable::INVALID_FLOW; //!< flow returned by selectQueue, INVALID_FLOW after the schedule changed
   uint32_t m_maxPackets;              //!< max packets in the queue
   uint32_t m_maxBytes;                //!< max bytes in the queue
   uint32_t m_bytesInQueue;            //!< actual bytes in the queue
+  uint32_t m_packetsInQueue;          //!< actual packets in the queue
+  std::array<uint32_t, ndn::FlowClassifier::QCI_BUCKETS> m_qciPackets; //!< packets in the queue per QCI class
+  std::array<uint32_t, ndn::FlowClassifier::QCI_BUCKETS> m_qciBytes;   //!< bytes in the queue per QCI class
   QueueMode m_mode;                   //!< queue mode (packets or bytes limited)
+  bool m_finishTimeTag;               //!< attach VirtualFinishTimeTag to queued packets
+  QciSet m_freshestQcis;              //!< real-time classes whose flows drop their oldest packets first
+  uint32_t m_freshestMaxPackets;      //!< max packets of a flow of a FreshestQcis class, 0 for no cap
+  uint32_t m_buckets;                 //!< number of hash buckets, 0 for a queue per flow
+  Time m_perturbInterval;             //!< time between changes of the bucket hash
+  Time m_nextPerturbation;            //!< time of the next change of the bucket hash
+  uint64_t m_perturbation;            //!< current salt of the bucket hash
 };
 
 } // namespace ns3
@@ -0,0 +1,172 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef FLOWCLASSINDEX_H
+#define FLOWCLASSINDEX_H
+
+#include <inttypes.h>
+#include <limits>
+#include <vector>
+
+#include "flow-classifier.hpp"
+
+namespace ns3 {
+
+/**
+ * \brief Groups flow ids by QCI class
+ *
+ * Every contained flow belongs to exactly one class and is linked into an
+ * intrusive list of its class. A bitmap of non-empty classes answers which
+ * is the lowest priority (largest QCI value) class with flows. Insert,
+ * remove, move and the lookup are O(1).
+ *
+ * WFQ indexes its flows by the QCI of their tail packet, which lets the
+ * push-out drop policy find a victim without scanning the flows.
+ */
+class FlowClassIndex
+{
+public:
+  static const uint32_t NONE = std::numeric_limits<uint32_t>::max ();
+  static const uint32_t CLASSES = ndn::FlowClassifier::QCI_BUCKETS;
+
+  FlowClassIndex ()
+    : m_first (CLASSES, NONE)
+  {
+    for (uint32_t i = 0; i < WORDS; i++)
+      {
+        m_nonEmpty[i] = 0;
+      }
+  }
+
+  bool
+  contains (uint32_t flowId) const
+  {
+    return flowId < m_class.size () && m_class[flowId] != NONE;
+  }
+
+  /**
+   * \brief Returns the class of a contained flow
+   */
+  uint32_t
+  getClass (uint32_t flowId) const
+  {
+    return m_class[flowId];
+  }
+
+  /**
+   * \brief Adds a flow which is not contained yet to the given class
+   */
+  void
+  insert (uint32_t flowId, uint32_t qci)
+  {
+    if (flowId >= m_class.size ())
+      {
+        m_class.resize (flowId + 1, NONE);
+        m_prev.resize (flowId + 1, NONE);
+        m_next.resize (flowId + 1, NONE);
+      }
+    m_class[flowId] = qci;
+    m_prev[flowId] = NONE;
+    m_next[flowId] = m_first[qci];
+    if (m_first[qci] != NONE)
+      {
+        m_prev[m_first[qci]] = flowId;
+      }
+    m_first[qci] = flowId;
+    m_nonEmpty[qci / 64] |= uint64_t (1) << (qci % 64);
+  }
+
+  /**
+   * \brief Removes a contained flow
+   */
+  void
+  remove (uint32_t flowId)
+  {
+    uint32_t qci = m_class[flowId];
+    if (m_prev[flowId] != NONE)
+      {
+        m_next[m_prev[flowId]] = m_next[flowId];
+      }
+    else
+      {
+        m_first[qci] = m_next[flowId];
+      }
+    if (m_next[flowId] != NONE)
+      {
+        m_prev[m_next[flowId]] = m_prev[flowId];
+      }
+    m_class[flowId] = NONE;
+    if (m_first[qci] == NONE)
+      {
+        m_nonEmpty[qci / 64] &= ~(uint64_t (1) << (qci % 64));
+      }
+  }
+
+  /**
+   * \brief Puts a flow into the given class, whether it is contained or not
+   */
+  void
+  update (uint32_t flowId, uint32_t qci)
+  {
+    if (contains (flowId))
+      {
+        if (m_class[flowId] == qci)
+          {
+            return;
+          }
+        remove (flowId);
+      }
+    insert (flowId, qci);
+  }
+
+  /**
+   * \brief Returns the largest QCI value with flows, NONE if no flow is contained
+   */
+  uint32_t
+  lastClass () const
+  {
+    for (uint32_t word = WORDS; word > 0; word--)
+      {
+        if (m_nonEmpty[word - 1] != 0)
+          {
+            return (word - 1) * 64 + 63 - __builtin_clzll (m_nonEmpty[word - 1]);
+          }
+      }
+    return NONE;
+  }
+
+  /**
+   * \brief Returns a flow of the given class, NONE if the class is empty
+   */
+  uint32_t
+  firstFlow (uint32_t qci) const
+  {
+    return m_first[qci];
+  }
+
+private:
+  static const uint32_t WORDS = CLASSES / 64;
+
+  std::vector<uint32_t> m_class; //!< class of every flow id, NONE if not contained
+  std::vector<uint32_t> m_prev;  //!< previous flow in the list of the same class
+  std::vector<uint32_t> m_next;  //!< next flow in the list of the same class
+  std::vector<uint32_t> m_first; //!< first flow of every class
+  uint64_t m_nonEmpty[WORDS];    //!< bitmap of classes with flows
+};
+
+} // namespace ns3
+
+#endif /* FLOWCLASSINDEX_H */
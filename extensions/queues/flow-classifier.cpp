@@ -0,0 +1,477 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+ * Copyright (c) 2011-2015  Regents of the University of California.
+ *
+ * This file is part of ndnSIM. See AUTHORS for complete list of ndnSIM authors and
+ * contributors.
+ *
+ * ndnSIM is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * ndnSIM is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ndnSIM, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#include "flow-classifier.hpp"
+
+#include "ns3/ndnSIM/ndn-cxx/encoding/qci.hpp"
+#include "ns3/header.h"
+
+#include <ndn-cxx/encoding/tlv.hpp>
+#include <ndn-cxx/name.hpp>
+
+#include <algorithm>
+#include <sstream>
+
+namespace ns3 {
+namespace ndn {
+
+const size_t FlowClassifier::DEFAULT_PREFIX_LENGTH;
+const uint32_t FlowClassifier::QCI_BUCKETS;
+const size_t FlowClassifier::MAX_PREFIX_LENGTH;
+const uint32_t FlowClassifier::NO_RULE;
+
+namespace {
+
+// NDNLP TLV types, the link layer may wrap network packets into an LpPacket
+const uint64_t LP_PACKET = 100;
+const uint64_t LP_FRAGMENT = 80;
+
+// Size of the PppHeader in front of the NDN packet on point-to-point links
+const uint32_t PPP_HEADER_SIZE = 2;
+
+const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ULL;
+const uint64_t FNV_PRIME = 1099511628211ULL;
+
+/**
+ * @brief Reads a TLV encoding from a buffer in memory
+ */
+class WireReader
+{
+public:
+  WireReader(const uint8_t* wire, size_t size)
+    : m_wire(wire)
+    , m_size(size)
+    , m_pos(0)
+  {
+  }
+
+  bool
+  read(uint8_t& byte)
+  {
+    if (m_pos >= m_size) {
+      return false;
+    }
+    byte = m_wire[m_pos++];
+    return true;
+  }
+
+  bool
+  skip(size_t length)
+  {
+    if (length > m_size - m_pos) {
+      return false;
+    }
+    m_pos += length;
+    return true;
+  }
+
+  size_t
+  position() const
+  {
+    return m_pos;
+  }
+
+private:
+  const uint8_t* m_wire;
+  size_t m_size;
+  size_t m_pos;
+};
+
+/**
+ * @brief Reads a TLV encoding in place from the buffer of an ns-3 packet
+ */
+class BufferReader
+{
+public:
+  explicit
+  BufferReader(Buffer::Iterator start)
+    : m_iterator(start)
+    , m_remaining(start.GetRemainingSize())
+    , m_pos(0)
+  {
+  }
+
+  bool
+  read(uint8_t& byte)
+  {
+    if (m_remaining == 0) {
+      return false;
+    }
+    byte = m_iterator.ReadU8();
+    m_remaining--;
+    m_pos++;
+    return true;
+  }
+
+  bool
+  skip(size_t length)
+  {
+    if (length > m_remaining) {
+      return false;
+    }
+    m_iterator.Next(length);
+    m_remaining -= length;
+    m_pos += length;
+    return true;
+  }
+
+  size_t
+  position() const
+  {
+    return m_pos;
+  }
+
+private:
+  Buffer::Iterator m_iterator;
+  size_t m_remaining;
+  size_t m_pos;
+};
+
+/**
+ * @brief Reads a TLV-TYPE or TLV-LENGTH number
+ */
+template<class Reader>
+bool
+readVarNumber(Reader& reader, uint64_t& number)
+{
+  uint8_t first = 0;
+  if (!reader.read(first)) {
+    return false;
+  }
+
+  size_t length = 0;
+  if (first < 253) {
+    number = first;
+    return true;
+  }
+  else if (first == 253) {
+    length = 2;
+  }
+  else if (first == 254) {
+    length = 4;
+  }
+  else {
+    length = 8;
+  }
+
+  number = 0;
+  for (size_t i = 0; i < length; i++) {
+    uint8_t byte = 0;
+    if (!reader.read(byte)) {
+      return false;
+    }
+    number = (number << 8) | byte;
+  }
+  return true;
+}
+
+/**
+ * @brief Reads the TLV-TYPE and TLV-LENGTH of an element, leaving the reader at its value
+ */
+template<class Reader>
+bool
+readHeader(Reader& reader, uint64_t& type, uint64_t& length)
+{
+  return readVarNumber(reader, type) && readVarNumber(reader, length);
+}
+
+/**
+ * @brief Header which classifies the NDN packet behind the PPP header when it is peeked
+ *
+ * Packet::PeekHeader hands Deserialize an iterator on the packet's own buffer, which
+ * is the only way to read a packet in place through the public Packet interface.
+ */
+class ClassifyingHeader : public Header
+{
+public:
+  ClassifyingHeader(const FlowClassifier& classifier, FlowInfo& info)
+    : m_classifier(classifier)
+    , m_info(info)
+  {
+  }
+
+  static TypeId
+  GetTypeId()
+  {
+    static TypeId tid = TypeId("ns3::ndn::ClassifyingHeader")
+      .SetParent<Header>()
+      .SetGroupName("Ndn");
+    return tid;
+  }
+
+  virtual TypeId
+  GetInstanceTypeId() const
+  {
+    return GetTypeId();
+  }
+
+  virtual uint32_t
+  GetSerializedSize() const
+  {
+    return 0;
+  }
+
+  virtual void
+  Serialize(Buffer::Iterator start) const
+  {
+  }
+
+  virtual uint32_t
+  Deserialize(Buffer::Iterator start)
+  {
+    if (start.GetRemainingSize() > PPP_HEADER_SIZE) {
+      start.Next(PPP_HEADER_SIZE);
+      m_classifier.classify(start, m_info);
+    }
+    return 0;
+  }
+
+  virtual void
+  Print(std::ostream& os) const
+  {
+    os << "type=" << m_info.type << " flow=" << m_info.flowKey << " qci=" << m_info.qci;
+  }
+
+private:
+  const FlowClassifier& m_classifier;
+  FlowInfo& m_info;
+};
+
+} // namespace
+
+FlowClassifier::FlowClassifier(size_t prefixLength)
+  : m_defaultPrefixLength(prefixLength)
+  , m_prefixLength(prefixLength)
+{
+}
+
+void
+FlowClassifier::setRules(const std::string& rules)
+{
+  size_t prefixLength = m_defaultPrefixLength;
+  std::unordered_map<uint64_t, uint32_t> trie;
+
+  std::string entries = rules;
+  std::replace(entries.begin(), entries.end(), ',', ' ');
+  std::replace(entries.begin(), entries.end(), ';', ' ');
+  std::istringstream is(entries);
+  std::string entry;
+  while (is >> entry) {
+    size_t separator = entry.rfind('=');
+    if (separator == std::string::npos || separator + 1 == entry.size()) {
+      throw Error("Flow rule `" + entry + "` is not of the form prefix=length");
+    }
+
+    size_t length = 0;
+    size_t parsed = 0;
+    try {
+      length = std::stoul(entry.substr(separator + 1), &parsed);
+    }
+    catch (const std::logic_error&) {
+      parsed = 0;
+    }
+    if (parsed != entry.size() - separator - 1 || length > MAX_PREFIX_LENGTH) {
+      throw Error("Flow rule `" + entry + "` has an invalid prefix length");
+    }
+
+    ::ndn::Name prefix;
+    try {
+      prefix = ::ndn::Name(entry.substr(0, separator));
+    }
+    catch (const std::exception&) {
+      throw Error("Flow rule `" + entry + "` has an invalid prefix");
+    }
+
+    if (prefix.size() == 0) {
+      prefixLength = length;
+      continue;
+    }
+
+    // Insert the inner nodes leading to the rule, keyed like the flow keys of their prefixes
+    for (size_t i = 1; i < prefix.size(); i++) {
+      trie.insert(std::make_pair(flowKey(prefix.getPrefix(i)), NO_RULE));
+    }
+    trie[flowKey(prefix)] = length;
+  }
+
+  m_prefixLength = prefixLength;
+  m_trie.swap(trie);
+  m_rules = rules;
+}
+
+uint64_t
+FlowClassifier::flowKey(const ::ndn::Name& prefix)
+{
+  uint64_t hash = FNV_OFFSET_BASIS;
+  for (size_t i = 0; i < prefix.size(); i++) {
+    const ::ndn::Block& component = prefix.get(i).wireEncode();
+    for (auto byte = component.begin(); byte != component.end(); ++byte) {
+      hash = (hash ^ *byte) * FNV_PRIME;
+    }
+  }
+  return hash;
+}
+
+FlowInfo
+FlowClassifier::classify(Ptr<const Packet> packet) const
+{
+  FlowInfo info;
+  ClassifyingHeader header(*this, info);
+  packet->PeekHeader(header);
+  return info;
+}
+
+bool
+FlowClassifier::classify(const uint8_t* wire, size_t size, FlowInfo& info) const
+{
+  return classifyTlv(WireReader(wire, size), info);
+}
+
+bool
+FlowClassifier::classify(Buffer::Iterator start, FlowInfo& info) const
+{
+  return classifyTlv(BufferReader(start), info);
+}
+
+template<class Reader>
+bool
+FlowClassifier::classifyTlv(Reader reader, FlowInfo& info) const
+{
+  info = FlowInfo();
+  info.qci = QCI_CLASSES::QCI_9;
+
+  uint64_t type = 0;
+  uint64_t length = 0;
+  if (!readHeader(reader, type, length)) {
+    return false;
+  }
+
+  // Unwrap the network packet carried in the fragment of an LpPacket
+  if (type == LP_PACKET) {
+    size_t end = reader.position() + length;
+    while (true) {
+      if (reader.position() >= end || !readHeader(reader, type, length)) {
+        return false;
+      }
+      if (type == LP_FRAGMENT) {
+        break;
+      }
+      if (!reader.skip(length)) {
+        return false;
+      }
+    }
+    if (!readHeader(reader, type, length)) {
+      return false;
+    }
+  }
+
+  if (type != ::ndn::tlv::Interest && type != ::ndn::tlv::Data) {
+    return false;
+  }
+  info.type = type;
+
+  size_t end = reader.position() + length;
+  bool hasName = false;
+  while (reader.position() < end) {
+    if (!readHeader(reader, type, length)) {
+      break;
+    }
+
+    if (type == ::ndn::tlv::Name) {
+      // Hash the complete TLV encoding of the components, which keeps /a/bc and
+      // /ab/c apart. prefixHash[i] is the flow key of the first i components.
+      uint64_t prefixHash[MAX_PREFIX_LENGTH + 1];
+      prefixHash[0] = FNV_OFFSET_BASIS;
+      size_t prefixLength = m_prefixLength;
+      bool inTrie = !m_trie.empty();
+
+      // The components are read with a copy, the name is skipped as a whole below
+      Reader component = reader;
+      size_t nameEnd = reader.position() + length;
+      size_t nComponents = 0;
+      uint64_t hash = FNV_OFFSET_BASIS;
+      while (component.position() < nameEnd && nComponents < MAX_PREFIX_LENGTH &&
+             (inTrie || nComponents < prefixLength)) {
+        Reader componentStart = component;
+        uint64_t componentType = 0;
+        uint64_t componentLength = 0;
+        if (!readHeader(component, componentType, componentLength)) {
+          break;
+        }
+        size_t componentEnd = std::min(component.position() + static_cast<size_t>(componentLength),
+                                       nameEnd);
+        component = componentStart;
+        uint8_t byte = 0;
+        while (component.position() < componentEnd && component.read(byte)) {
+          hash = (hash ^ byte) * FNV_PRIME;
+        }
+        prefixHash[++nComponents] = hash;
+
+        // Follow the rule trie, the longest matching rule wins
+        if (inTrie) {
+          matchRule(hash, inTrie, prefixLength);
+        }
+      }
+      info.flowKey = prefixHash[std::min(prefixLength, nComponents)];
+      hasName = true;
+    }
+    else if (type == ::ndn::tlv::QCI) {
+      uint64_t qci = 0;
+      uint8_t byte = 0;
+      size_t i = 0;
+      for (; i < length && reader.read(byte); i++) {
+        qci = (qci << 8) | byte;
+      }
+      if (i < length) {
+        break;
+      }
+      if (qci != 0) {
+        info.qci = qci < QCI_BUCKETS ? qci : QCI_BUCKETS - 1;
+      }
+      continue;
+    }
+    else if (type == ::ndn::tlv::MessageType) {
+      static const uint8_t PUSH[] = {'p', 'u', 's', 'h'};
+      bool push = length == sizeof(PUSH);
+      uint8_t byte = 0;
+      size_t i = 0;
+      for (; i < length && reader.read(byte); i++) {
+        push = push && byte == PUSH[i];
+      }
+      if (i < length) {
+        break;
+      }
+      info.push = push;
+      continue;
+    }
+    else if (hasName) {
+      // QCI and MessageType are encoded right after the Name, no need to look further
+      break;
+    }
+
+    if (!reader.skip(length)) {
+      break;
+    }
+  }
+
+  return hasName;
+}
+
+} // namespace ndn
+} // namespace ns3
@@ -0,0 +1,211 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+ * Copyright (c) 2011-2015  Regents of the University of California.
+ *
+ * This file is part of ndnSIM. See AUTHORS for complete list of ndnSIM authors and
+ * contributors.
+ *
+ * ndnSIM is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * ndnSIM is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ndnSIM, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef NDN_QUEUE_FLOW_CLASSIFIER_H
+#define NDN_QUEUE_FLOW_CLASSIFIER_H
+
+#include <stddef.h>
+#include <inttypes.h>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+#include "ns3/packet.h"
+#include "ns3/buffer.h"
+
+namespace ndn {
+class Name;
+} // namespace ndn
+
+namespace ns3 {
+namespace ndn {
+
+/**
+ * @brief Flow identity and QoS class of a queued NDN packet
+ */
+struct FlowInfo
+{
+  uint32_t type = 0;    //!< TLV type of the network packet (Interest or Data), 0 if unknown
+  uint64_t flowKey = 0; //!< Hash over the first name components, 0 if unknown
+  uint32_t qci = 0;     //!< QCI class, QCI_9 if the packet does not carry one
+  bool push = false;    //!< Whether the packet is a persistent Interest or pushed Data
+};
+
+/**
+ * @ingroup ndn-fw
+ * @brief Classifies NDN packets into traffic flows directly on the TLV wire encoding
+ *
+ * The classifier walks the outer TLV, the Name, the QCI and the MessageType element of an
+ * Interest or Data packet without decoding it into ndn-cxx objects. A flow is identified by the
+ * first components of the name (by default two, e.g. /prefix/stream), which are hashed
+ * into a 64 bit flow key. NDNLP framed packets are classified by their fragment.
+ *
+ * The number of components can be chosen per name prefix with rules, see setRules.
+ * The rules are compiled into a trie of name components. Its nodes are keyed by the
+ * hash of the prefix leading to them, which is the same running hash that produces the
+ * flow key, so the name is still read in a single pass with one table lookup per
+ * component and without building strings.
+ */
+class FlowClassifier {
+public:
+  class Error : public std::runtime_error
+  {
+  public:
+    explicit
+    Error(const std::string& what)
+      : std::runtime_error(what)
+    {
+    }
+  };
+
+  /**
+   * @brief Number of name components which identify a flow by default
+   */
+  static const size_t DEFAULT_PREFIX_LENGTH = 2;
+
+  /**
+   * @brief Number of distinct QCI values the queues keep state for.
+   *
+   * Larger QCI values are clamped to the lowest priority QCI_BUCKETS - 1.
+   */
+  static const uint32_t QCI_BUCKETS = 128;
+
+  /**
+   * @brief Largest number of name components a rule may use for flows
+   */
+  static const size_t MAX_PREFIX_LENGTH = 32;
+
+  explicit
+  FlowClassifier(size_t prefixLength = DEFAULT_PREFIX_LENGTH);
+
+  /**
+   * @brief Classifies a packet handed to a point-to-point device queue
+   *
+   * The packet is expected to start with a PPP header followed by the NDN packet.
+   * The TLV is read in place through Packet::PeekHeader, without copying the packet
+   * or its bytes, and only up to the elements the classification needs.
+   */
+  FlowInfo
+  classify(Ptr<const Packet> packet) const;
+
+  /**
+   * @brief Classifies the TLV encoded NDN packet in the given buffer
+   *
+   * @param wire Start of the NDN packet
+   * @param size Number of bytes available in the buffer, may be less than the packet size
+   * @param info Receives the classification result
+   * @return false if the buffer does not start with an Interest or Data
+   */
+  bool
+  classify(const uint8_t* wire, size_t size, FlowInfo& info) const;
+
+  /**
+   * @brief Classifies the TLV encoded NDN packet starting at the iterator
+   *
+   * @param start Iterator on the first byte of the NDN packet
+   * @param info Receives the classification result
+   * @return false if the buffer does not start with an Interest or Data
+   */
+  bool
+  classify(Buffer::Iterator start, FlowInfo& info) const;
+
+  /**
+   * @brief Returns the flow key of the names whose flow is identified by the given prefix
+   *
+   * E.g. with the default prefix length the flow key of /prefix/stream/seq=1 equals
+   * flowKey("/prefix/stream").
+   */
+  static uint64_t
+  flowKey(const ::ndn::Name& prefix);
+
+  /**
+   * @brief Replaces the flow separation rules
+   *
+   * The rules are a list of `prefix=length` entries separated by whitespace, `,` or `;`,
+   * e.g. "/=2 /video=4 /sensors=1". Names are separated into flows by their first
+   * `length` components, taken from the rule with the longest matching prefix. The rule
+   * for "/" replaces the default prefix length, a rule shorter than its prefix aggregates
+   * all names under the prefix into fewer flows. An empty string restores the default.
+   *
+   * @throw Error if an entry cannot be parsed
+   */
+  void
+  setRules(const std::string& rules);
+
+  /**
+   * @brief Returns the rules set with setRules
+   */
+  const std::string&
+  getRules() const
+  {
+    return m_rules;
+  }
+
+  /**
+   * @brief Returns the number of components separating flows without a matching rule
+   */
+  size_t
+  getPrefixLength() const
+  {
+    return m_prefixLength;
+  }
+
+private:
+  /**
+   * @brief Walks the TLV of an NDN packet, Reader is one of the byte sources in the .cpp
+   */
+  template<class Reader>
+  bool
+  classifyTlv(Reader reader, FlowInfo& info) const;
+
+  /**
+   * @brief Follows the rule trie to the prefix with the given hash
+   *
+   * @param inTrie Whether the previous prefix is a trie node, cleared if this one is not
+   * @param prefixLength Receives the length of the rule ending at the node, if any
+   */
+  void
+  matchRule(uint64_t hash, bool& inTrie, size_t& prefixLength) const
+  {
+    auto node = m_trie.find(hash);
+    if (node == m_trie.end()) {
+      inTrie = false;
+    }
+    else if (node->second != NO_RULE) {
+      prefixLength = node->second;
+    }
+  }
+
+  static const uint32_t NO_RULE = static_cast<uint32_t>(-1);
+
+  size_t m_defaultPrefixLength;  //!< prefix length given to the constructor
+  size_t m_prefixLength;         //!< prefix length of names without a matching rule
+  std::string m_rules;           //!< rules as given to setRules
+  /**
+   * @brief Nodes of the rule trie, keyed by the running hash of their prefix
+   *
+   * The value is the prefix length of the rule ending at the node, NO_RULE for inner nodes.
+   */
+  std::unordered_map<uint64_t, uint32_t> m_trie;
+};
+
+} // namespace ndn
+} // namespace ns3
+
+#endif // NDN_QUEUE_FLOW_CLASSIFIER_H
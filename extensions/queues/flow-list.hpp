@@ -0,0 +1,154 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef FLOWLIST_H
+#define FLOWLIST_H
+
+#include <inttypes.h>
+#include <vector>
+
+#include "flow-table.hpp"
+
+namespace ns3 {
+
+/**
+ * \brief Circular list of the active flows of a round robin scheduler
+ *
+ * The links are kept per flow id, next to the other per-flow arrays of the
+ * queue, so adding a flow, removing any flow and advancing to the next flow
+ * are O(1) and do not allocate once the ids reached their largest value.
+ * The head is the flow to serve next. Flows are added at the tail, behind
+ * all flows waiting for their turn, and removing a flow keeps the order of
+ * the others.
+ */
+class FlowList
+{
+public:
+  /**
+   * \brief Returns the flow to serve next, INVALID_FLOW if the list is empty
+   */
+  uint32_t
+  front () const
+  {
+    return m_head;
+  }
+
+  /**
+   * \brief Adds a flow which is not in the list at the tail
+   */
+  void
+  push_back (uint32_t flowId)
+  {
+    if (flowId >= m_links.size ())
+      {
+        m_links.resize (flowId + 1);
+      }
+
+    Link& link = m_links[flowId];
+    if (m_head == FlowTable::INVALID_FLOW)
+      {
+        link.prev = flowId;
+        link.next = flowId;
+        m_head = flowId;
+      }
+    else
+      {
+        uint32_t tail = m_links[m_head].prev;
+        link.prev = tail;
+        link.next = m_head;
+        m_links[tail].next = flowId;
+        m_links[m_head].prev = flowId;
+      }
+    m_size++;
+  }
+
+  /**
+   * \brief Removes a flow of the list, the head moves on if the flow is the head
+   */
+  void
+  erase (uint32_t flowId)
+  {
+    Link& link = m_links[flowId];
+    if (link.next == flowId)
+      {
+        m_head = FlowTable::INVALID_FLOW;
+      }
+    else
+      {
+        m_links[link.prev].next = link.next;
+        m_links[link.next].prev = link.prev;
+        if (m_head == flowId)
+          {
+            m_head = link.next;
+          }
+      }
+    m_size--;
+  }
+
+  /**
+   * \brief Moves the head to the next flow, the former head becomes the tail
+   */
+  void
+  advance ()
+  {
+    if (m_head != FlowTable::INVALID_FLOW)
+      {
+        m_head = m_links[m_head].next;
+      }
+  }
+
+  /**
+   * \brief Reserves the links of the given number of flow ids
+   */
+  void
+  reserve (uint32_t flows)
+  {
+    if (flows > m_links.size ())
+      {
+        m_links.resize (flows);
+      }
+  }
+
+  bool
+  empty () const
+  {
+    return m_size == 0;
+  }
+
+  uint32_t
+  size () const
+  {
+    return m_size;
+  }
+
+private:
+  /**
+   * \brief Neighbours of a flow in the list
+   */
+  struct Link
+  {
+    uint32_t prev = FlowTable::INVALID_FLOW; //!< flow served before
+    uint32_t next = FlowTable::INVALID_FLOW; //!< flow served after
+  };
+
+  std::vector<Link> m_links;                 //!< links of every flow id
+  uint32_t m_head = FlowTable::INVALID_FLOW; //!< flow to serve next
+  uint32_t m_size = 0;                       //!< number of flows in the list
+};
+
+} // namespace ns3
+
+#endif /* FLOWLIST_H */
@@ -0,0 +1,219 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef FLOWRING_H
+#define FLOWRING_H
+
+#include <inttypes.h>
+#include <vector>
+#include "ns3/packet.h"
+#include "ns3/nstime.h"
+
+#include "virtual-time.hpp"
+
+namespace ns3 {
+
+/**
+ * \brief FIFO of the packets of one traffic flow with their scheduling metadata
+ *
+ * The packets and each metadata field are kept in parallel arrays which are
+ * used as a ring buffer, so the scheduler reads the metadata it needs without
+ * touching the packets or their tags. The capacity is a power of two and
+ * doubles when the ring is full; it never shrinks while the flow exists.
+ *
+ * Index 0 refers to the head (oldest) packet, size () - 1 to the tail.
+ */
+class FlowRing
+{
+public:
+  FlowRing ()
+    : m_head (0),
+      m_size (0)
+  {
+  }
+
+  bool
+  empty () const
+  {
+    return m_size == 0;
+  }
+
+  uint32_t
+  size () const
+  {
+    return m_size;
+  }
+
+  /**
+   * \brief Appends a packet at the tail, the virtual times are initialized with zero
+   */
+  void
+  push_back (Ptr<Packet> packet, uint32_t qci, uint64_t flowKey, Time enqueueTime)
+  {
+    if (m_size == m_packets.size ())
+      {
+        grow ();
+      }
+    uint32_t i = slot (m_size++);
+    m_packets[i] = packet;
+    m_qci[i] = qci;
+    m_flowKey[i] = flowKey;
+    m_bytes[i] = packet->GetSize ();
+    m_enqueueTime[i] = enqueueTime;
+    m_virtualStart[i] = 0;
+    m_virtualFinish[i] = 0;
+  }
+
+  /**
+   * \brief Removes and returns the head packet
+   */
+  Ptr<Packet>
+  pop_front ()
+  {
+    uint32_t i = slot (0);
+    Ptr<Packet> packet = m_packets[i];
+    m_packets[i] = 0;
+    m_head = (m_head + 1) & mask ();
+    m_size--;
+    return packet;
+  }
+
+  /**
+   * \brief Removes and returns the tail packet
+   */
+  Ptr<Packet>
+  pop_back ()
+  {
+    uint32_t i = slot (m_size - 1);
+    Ptr<Packet> packet = m_packets[i];
+    m_packets[i] = 0;
+    m_size--;
+    return packet;
+  }
+
+  Ptr<Packet>
+  packet (uint32_t index) const
+  {
+    return m_packets[slot (index)];
+  }
+
+  uint32_t
+  qci (uint32_t index) const
+  {
+    return m_qci[slot (index)];
+  }
+
+  /**
+   * \brief Returns the flow key of a packet as computed by ndn::FlowClassifier
+   *
+   * Queues which aggregate several flows in one ring still know the flow of every packet.
+   */
+  uint64_t
+  flowKey (uint32_t index) const
+  {
+    return m_flowKey[slot (index)];
+  }
+
+  uint32_t
+  bytes (uint32_t index) const
+  {
+    return m_bytes[slot (index)];
+  }
+
+  Time
+  enqueueTime (uint32_t index) const
+  {
+    return m_enqueueTime[slot (index)];
+  }
+
+  VirtualTime&
+  virtualStart (uint32_t index)
+  {
+    return m_virtualStart[slot (index)];
+  }
+
+  VirtualTime
+  virtualStart (uint32_t index) const
+  {
+    return m_virtualStart[slot (index)];
+  }
+
+  VirtualTime&
+  virtualFinish (uint32_t index)
+  {
+    return m_virtualFinish[slot (index)];
+  }
+
+  VirtualTime
+  virtualFinish (uint32_t index) const
+  {
+    return m_virtualFinish[slot (index)];
+  }
+
+private:
+  uint32_t
+  mask () const
+  {
+    return m_packets.size () - 1;
+  }
+
+  uint32_t
+  slot (uint32_t index) const
+  {
+    return (m_head + index) & mask ();
+  }
+
+  template <typename T>
+  void
+  unwrap (std::vector<T>& field, uint32_t capacity)
+  {
+    std::vector<T> resized (capacity);
+    for (uint32_t i = 0; i < m_size; i++)
+      {
+        resized[i] = field[slot (i)];
+      }
+    field.swap (resized);
+  }
+
+  void
+  grow ()
+  {
+    uint32_t capacity = m_packets.empty () ? 4 : 2 * m_packets.size ();
+    unwrap (m_qci, capacity);
+    unwrap (m_flowKey, capacity);
+    unwrap (m_bytes, capacity);
+    unwrap (m_enqueueTime, capacity);
+    unwrap (m_virtualStart, capacity);
+    unwrap (m_virtualFinish, capacity);
+    // Packets last, slot () depends on the capacity of m_packets
+    unwrap (m_packets, capacity);
+    m_head = 0;
+  }
+
+  std::vector<Ptr<Packet> > m_packets;  //!< the packets of the flow
+  std::vector<uint8_t> m_qci;           //!< QCI class of each packet
+  std::vector<uint64_t> m_flowKey;      //!< flow key of each packet
+  std::vector<uint32_t> m_bytes;        //!< size of each packet
+  std::vector<Time> m_enqueueTime;      //!< time each packet was enqueued
+  std::vector<VirtualTime> m_virtualStart;  //!< virtual start time of each packet
+  std::vector<VirtualTime> m_virtualFinish; //!< virtual finishing time of each packet
+  uint32_t m_head;                      //!< slot of the head packet
+  uint32_t m_size;                      //!< number of packets in the ring
+};
+
+} // namespace ns3
+
+#endif /* FLOWRING_H */
@@ -0,0 +1,131 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef FLOWTABLE_H
+#define FLOWTABLE_H
+
+#include <inttypes.h>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \brief Interns flow keys into dense flow ids
+ *
+ * Every flow with packets in a queue gets a small integer id, so queues can
+ * keep their per-flow state in flat arrays indexed by the id. Ids of flows
+ * that went idle are released and handed out again to new flows, which keeps
+ * the ids (and the per-flow arrays) bounded by the largest number of flows
+ * that were active at the same time.
+ */
+class FlowTable
+{
+public:
+  static const uint32_t INVALID_FLOW = std::numeric_limits<uint32_t>::max ();
+
+  /**
+   * \brief Returns the id of the given flow, assigning one if the flow is unknown
+   *
+   * \param flowKey Flow key as computed by ndn::FlowClassifier
+   * \param isNew Set to true if the flow got a new id
+   */
+  uint32_t
+  intern (uint64_t flowKey, bool& isNew)
+  {
+    auto res = m_ids.find (flowKey);
+    if (res != m_ids.end ())
+      {
+        isNew = false;
+        return res->second;
+      }
+
+    uint32_t id;
+    if (!m_free.empty ())
+      {
+        id = m_free.back ();
+        m_free.pop_back ();
+        m_keys[id] = flowKey;
+      }
+    else
+      {
+        id = m_keys.size ();
+        m_keys.push_back (flowKey);
+      }
+    m_ids.insert (std::make_pair (flowKey, id));
+    isNew = true;
+    return id;
+  }
+
+  /**
+   * \brief Returns the id of the given flow, INVALID_FLOW if the flow is unknown
+   */
+  uint32_t
+  find (uint64_t flowKey) const
+  {
+    auto res = m_ids.find (flowKey);
+    return res == m_ids.end () ? INVALID_FLOW : res->second;
+  }
+
+  /**
+   * \brief Releases the id of a flow which has no more packets queued
+   */
+  void
+  release (uint32_t flowId)
+  {
+    m_ids.erase (m_keys[flowId]);
+    m_free.push_back (flowId);
+  }
+
+  /**
+   * \brief Returns the flow key of an assigned id
+   */
+  uint64_t
+  getKey (uint32_t flowId) const
+  {
+    return m_keys[flowId];
+  }
+
+  /**
+   * \brief Returns the number of flows which currently hold an id
+   */
+  uint32_t
+  size () const
+  {
+    return m_ids.size ();
+  }
+
+  /**
+   * \brief Returns an upper bound for all ids handed out so far
+   *
+   * Per-flow arrays with this many entries can be indexed by every id.
+   */
+  uint32_t
+  capacity () const
+  {
+    return m_keys.size ();
+  }
+
+private:
+  std::unordered_map<uint64_t, uint32_t> m_ids; //!< ids of the known flows
+  std::vector<uint64_t> m_keys;                  //!< flow key of every id
+  std::vector<uint32_t> m_free;                  //!< released ids
+};
+
+} // namespace ns3
+
+#endif /* FLOWTABLE_H */
@@ -0,0 +1,302 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2007 University of Washington
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/log.h"
+#include "ns3/string.h"
+#include "ns3/simulator.h"
+
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+
+#include "fq-codel-queue.hpp"
+#include "class-list.hpp"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("FqCoDelQueue");
+
+NS_OBJECT_ENSURE_REGISTERED (FqCoDelQueue);
+
+namespace {
+
+/**
+ * \brief Returns the time of the next drop, interval / sqrt(count) after t
+ */
+Time
+controlLaw(Time t, Time interval, uint32_t count)
+{
+  return t + NanoSeconds(static_cast<uint64_t>(interval.GetNanoSeconds() / std::sqrt(count)));
+}
+
+/**
+ * \brief Parses a list of `qci=time` entries, zero for the classes which are not listed
+ *
+ * \throw std::invalid_argument if an entry cannot be parsed
+ */
+std::array<Time, ndn::FlowClassifier::QCI_BUCKETS>
+parseTimes(const std::string& list, const std::string& what)
+{
+  std::array<Time, ndn::FlowClassifier::QCI_BUCKETS> values;
+  for (const auto& entry : parseClassList(list)) {
+    std::istringstream value (entry.second);
+    Time time;
+    value >> time;
+    if (value.fail() || time.IsStrictlyNegative()) {
+      throw std::invalid_argument(what + " `" + entry.second + "` is not a time");
+    }
+    values[entry.first] = time;
+  }
+  return values;
+}
+
+} // namespace
+
+TypeId FqCoDelQueue::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::FqCoDelQueue")
+    .SetParent<DrrQueue> ()
+    .SetGroupName("Network")
+    .AddConstructor<FqCoDelQueue> ()
+    .AddAttribute ("Target",
+                   "The sojourn time target of QCI classes without an own target.",
+                   TimeValue (MilliSeconds (5)),
+                   MakeTimeAccessor (&FqCoDelQueue::m_target),
+                   MakeTimeChecker ())
+    .AddAttribute ("Interval",
+                   "The interval of QCI classes without an own interval.",
+                   TimeValue (MilliSeconds (100)),
+                   MakeTimeAccessor (&FqCoDelQueue::m_interval),
+                   MakeTimeChecker ())
+    .AddAttribute ("Targets",
+                   "Sojourn time targets of QCI classes, e.g. \"20=1ms 90=20ms\", other classes use Target.",
+                   StringValue (""),
+                   MakeStringAccessor (&FqCoDelQueue::SetTargets,
+                                       &FqCoDelQueue::GetTargets),
+                   MakeStringChecker ())
+    .AddAttribute ("Intervals",
+                   "Intervals of QCI classes, e.g. \"20=20ms 90=200ms\", other classes use Interval.",
+                   StringValue (""),
+                   MakeStringAccessor (&FqCoDelQueue::SetIntervals,
+                                       &FqCoDelQueue::GetIntervals),
+                   MakeStringChecker ())
+  ;
+
+  return tid;
+}
+
+FqCoDelQueue::FqCoDelQueue () :
+  DrrQueue ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+FqCoDelQueue::~FqCoDelQueue ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+FqCoDelQueue::SetTarget (uint32_t qci, Time target)
+{
+  NS_LOG_FUNCTION (this << qci << target);
+  NS_ASSERT_MSG (qci < m_qciTarget.size(), "QCI class out of range");
+  m_qciTarget[qci] = target;
+}
+
+Time
+FqCoDelQueue::GetTarget (uint32_t qci) const
+{
+  if (qci < m_qciTarget.size() && !m_qciTarget[qci].IsZero()) {
+    return m_qciTarget[qci];
+  }
+  return m_target;
+}
+
+void
+FqCoDelQueue::SetInterval (uint32_t qci, Time interval)
+{
+  NS_LOG_FUNCTION (this << qci << interval);
+  NS_ASSERT_MSG (qci < m_qciInterval.size(), "QCI class out of range");
+  m_qciInterval[qci] = interval;
+}
+
+Time
+FqCoDelQueue::GetInterval (uint32_t qci) const
+{
+  if (qci < m_qciInterval.size() && !m_qciInterval[qci].IsZero()) {
+    return m_qciInterval[qci];
+  }
+  return m_interval;
+}
+
+void
+FqCoDelQueue::SetTargets (std::string targets)
+{
+  NS_LOG_FUNCTION (this << targets);
+  m_qciTarget = parseTimes(targets, "Target");
+  m_targets = targets;
+}
+
+std::string
+FqCoDelQueue::GetTargets (void) const
+{
+  return m_targets;
+}
+
+void
+FqCoDelQueue::SetIntervals (std::string intervals)
+{
+  NS_LOG_FUNCTION (this << intervals);
+  m_qciInterval = parseTimes(intervals, "Interval");
+  m_intervals = intervals;
+}
+
+std::string
+FqCoDelQueue::GetIntervals (void) const
+{
+  return m_intervals;
+}
+
+Ptr<Packet>
+FqCoDelQueue::DoDequeue (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  Time now = Simulator::Now();
+  while (m_packetsInQueue > 0)
+    {
+      if (shouldDrop(now))
+        {
+          NS_LOG_LOGIC ("Sojourn time above target -- dropping pkt of flow " << m_flows.getKey(m_round.first));
+          DropQueued (popFirst(false));
+          continue;
+        }
+
+      const FlowRing& queue = m_queues[m_round.first];
+      m_sojournStats->Record(queue.qci(0), queue.flowKey(0), now - queue.enqueueTime(0));
+      Ptr<Packet> p = popFirst(true);
+
+      NS_LOG_LOGIC ("Popped " << p);
+
+      NS_LOG_LOGIC ("Number packets " << m_packetsInQueue);
+      NS_LOG_LOGIC ("Number bytes " << m_bytesInQueue);
+      NS_LOG_LOGIC ("Number of queues " << m_flows.size());
+
+      return p;
+    }
+
+  NS_LOG_LOGIC ("Queue empty");
+  return 0;
+}
+
+Ptr<const Packet>
+FqCoDelQueue::DoPeek (void) const
+{
+  NS_LOG_FUNCTION (this);
+
+  if (m_packetsInQueue == 0)
+    {
+      NS_LOG_LOGIC ("Queue empty");
+      return 0;
+    }
+
+  // Run CoDel on a copy of the state, to skip the packets Dequeue would drop
+  uint32_t flowId = m_round.first;
+  const FlowRing& queue = m_queues[flowId];
+  CoDelState state = m_codel[flowId];
+  uint32_t head = 0;
+  while (decideDrop(state, queue, head, Simulator::Now())) {
+    head++;
+  }
+
+  // Drops are not charged, but the next flow takes over if the new head
+  // exceeds the deficit. Its own CoDel is not run here, so Dequeue may
+  // still drop the returned packet in that case.
+  if (head > 0 && m_drr.deficit(flowId) < queue.bytes(head)
+      && m_drr.next(flowId) != FlowTable::INVALID_FLOW)
+    {
+      return m_queues[m_drr.next(flowId)].packet(0);
+    }
+  return queue.packet(head);
+}
+
+void
+FqCoDelQueue::activate(uint32_t flowId)
+{
+  if (flowId >= m_codel.size()) {
+    m_codel.resize(flowId + 1);
+  }
+  m_codel[flowId] = CoDelState();
+  DrrQueue::activate(flowId);
+}
+
+bool
+FqCoDelQueue::shouldDrop(Time now)
+{
+  uint32_t flowId = m_round.first;
+  return decideDrop(m_codel[flowId], m_queues[flowId], 0, now);
+}
+
+bool
+FqCoDelQueue::decideDrop(CoDelState& state, const FlowRing& queue, uint32_t head, Time now) const
+{
+  Time target = GetTarget(queue.qci(head));
+  Time interval = GetInterval(queue.qci(head));
+
+  // Dropping becomes allowed once the sojourn time stayed above target for an interval
+  bool okToDrop = false;
+  if (now - queue.enqueueTime(head) < target || queue.size() - head == 1) {
+    state.firstAboveTime = Time();
+  } else if (state.firstAboveTime.IsZero()) {
+    state.firstAboveTime = now + interval;
+  } else if (now >= state.firstAboveTime) {
+    okToDrop = true;
+  }
+
+  if (state.dropping) {
+    if (!okToDrop) {
+      state.dropping = false;
+      return false;
+    }
+    if (now < state.dropNext) {
+      return false;
+    }
+    state.count++;
+    state.dropNext = controlLaw(state.dropNext, interval, state.count);
+    return true;
+  }
+
+  if (!okToDrop) {
+    return false;
+  }
+
+  // Start dropping, at the rate of the last dropping state if that ended recently
+  state.dropping = true;
+  uint32_t delta = state.count - state.lastCount;
+  if (delta > 1 && now - state.dropNext < NanoSeconds(static_cast<uint64_t>(16 * interval.GetNanoSeconds()))) {
+    state.count = delta;
+  } else {
+    state.count = 1;
+  }
+  state.lastCount = state.count;
+  state.dropNext = controlLaw(now, interval, state.count);
+  return true;
+}
+
+} // namespace ns3
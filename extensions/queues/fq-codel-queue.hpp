@@ -0,0 +1,160 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2007 University of Washington
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef FQCODELQUEUE_H
+#define FQCODELQUEUE_H
+
+#include <array>
+#include <string>
+#include <vector>
+#include "ns3/nstime.h"
+
+#include "drr-queue.hpp"
+
+namespace ns3 {
+
+/**
+ * \ingroup queue
+ *
+ * \brief A Deficit Round Robin queue with CoDel active queue management per flow
+ *
+ * Traffic flows are separated and scheduled like in DrrQueue. Additionally,
+ * every flow runs the CoDel algorithm (RFC 8289) on the sojourn time of its
+ * packets: once the sojourn time stayed above the target for an interval,
+ * packets are dropped from the head of the flow, at a rate which increases
+ * with the square root of the number of drops until the sojourn time falls
+ * below the target again. The last packet of a flow is never dropped.
+ *
+ * Target and interval are taken from the QCI class of the packet at the
+ * head of the flow, see the Targets and Intervals attributes, so real-time classes can
+ * keep their standing queues shorter than best effort traffic.
+ */
+class FqCoDelQueue : public DrrQueue {
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+  /**
+   * \brief FqCoDelQueue Constructor
+   */
+  FqCoDelQueue ();
+
+  virtual ~FqCoDelQueue();
+
+  /**
+   * \brief Sets the sojourn time target of the given QCI class
+   *
+   * \param qci The QCI class
+   * \param target The target, zero restores the Target attribute
+   */
+  void SetTarget (uint32_t qci, Time target);
+
+  /**
+   * \return The sojourn time target of the given QCI class
+   */
+  Time GetTarget (uint32_t qci) const;
+
+  /**
+   * \brief Sets the interval of the given QCI class
+   *
+   * \param qci The QCI class
+   * \param interval The interval, zero restores the Interval attribute
+   */
+  void SetInterval (uint32_t qci, Time interval);
+
+  /**
+   * \return The interval of the given QCI class
+   */
+  Time GetInterval (uint32_t qci) const;
+
+  /**
+   * \brief Sets the sojourn time targets of the QCI classes from a list
+   *
+   * \param targets List of `qci=time` entries separated by whitespace, `,`
+   * or `;`. Classes which are not listed use the Target attribute.
+   *
+   * \throw std::invalid_argument if an entry cannot be parsed
+   */
+  void SetTargets (std::string targets);
+
+  std::string GetTargets (void) const;
+
+  /**
+   * \brief Sets the intervals of the QCI classes from a list
+   *
+   * \param intervals List of `qci=time` entries separated by whitespace, `,`
+   * or `;`. Classes which are not listed use the Interval attribute.
+   *
+   * \throw std::invalid_argument if an entry cannot be parsed
+   */
+  void SetIntervals (std::string intervals);
+
+  std::string GetIntervals (void) const;
+
+protected:
+  virtual Ptr<Packet> DoDequeue (void);
+
+  /**
+   * \brief Returns the packet Dequeue would send, after the packets CoDel drops first
+   */
+  virtual Ptr<const Packet> DoPeek (void) const;
+
+  virtual void activate(uint32_t flowId);
+
+  /**
+   * \brief Runs CoDel on the head packet of the first active flow
+   *
+   * \return Whether the packet has to be dropped
+   */
+  bool shouldDrop(Time now);
+
+  /**
+   * \brief CoDel state of a traffic flow
+   */
+  struct CoDelState
+  {
+    Time firstAboveTime;  //!< time the sojourn time stays above target until dropping starts, zero if below
+    Time dropNext;        //!< time of the next drop while dropping
+    uint32_t count;       //!< drops since entering the dropping state
+    uint32_t lastCount;   //!< count when the dropping state was entered last
+    bool dropping;        //!< whether the flow is in the dropping state
+  };
+
+  /**
+   * \brief Runs CoDel on a packet of a flow as if the packets before it were gone
+   *
+   * \param state CoDel state of the flow, updated as Dequeue would
+   * \param head Index of the packet in the queue of the flow
+   * \return Whether the packet has to be dropped
+   */
+  bool decideDrop(CoDelState& state, const FlowRing& queue, uint32_t head, Time now) const;
+
+  std::vector<CoDelState> m_codel;    //!< CoDel state of every flow, indexed by flow id
+  std::array<Time, ndn::FlowClassifier::QCI_BUCKETS> m_qciTarget;   //!< target per QCI class, zero for the default
+  std::array<Time, ndn::FlowClassifier::QCI_BUCKETS> m_qciInterval; //!< interval per QCI class, zero for the default
+  std::string m_targets;              //!< targets as given to SetTargets
+  std::string m_intervals;            //!< intervals as given to SetIntervals
+  Time m_target;                      //!< default sojourn time target
+  Time m_interval;                    //!< default interval
+};
+
+} // namespace ns3
+
+#endif /* FQCODELQUEUE_H */
@@ -1,46 +1,44 @@
+
 #ifndef GENERICPRIORITYQUEUE_H
 #define GENERICPRIORITYQUEUE_H
 
 #include <vector>
-#include <algorithm>    // std::sort
-#include <iostream>
-#include <queue>
-#include <deque>
 #include <utility>
-#include <vector>
 #include <inttypes.h>
 
-template <typename T> 
-struct queue_comparator
-{
-    inline bool operator() (const std::pair <uint32_t, std::vector< T > > e1, 
-    						const std::pair <uint32_t, std::vector< T > > e2)
-    {
-        return (e1.first < e2.first);
-    }
-};
-
 /**
  * \class PriorityQueue
  * \brief Generic Priority Queue
  *
  * A generic priority queue which keeps packets utilizing the same priority class ordered.
+ * Lower priority values are served first.
+ *
+ * Every priority value has its own FIFO bucket (a ring buffer), and a bitmap marks the
+ * non-empty buckets. push, pop, top and size are O(1): the next bucket to serve is found
+ * with a count-trailing-zeros instruction on the bitmap. Priorities of Buckets or more
+ * share the last bucket. A bucket's storage grows to the largest number of elements it
+ * held and is reused afterwards.
  */
-template <class T> class PriorityQueue {
+template <class T, uint32_t Buckets = 128> class PriorityQueue {
+
+	static_assert(Buckets > 0 && Buckets % 64 == 0, "Buckets must be a multiple of 64");
 
 	public:
+		PriorityQueue()
+			: m_size(0)
+		{
+			for (uint32_t i = 0; i < WORDS; i++) {
+				m_nonEmpty[i] = 0;
+			}
+		}
+
 		/**
 		 * \brief Returns the current size of the queue
 		 */
 		uint32_t
 		size() const
 		{
-			uint32_t elemCount = 0;
-			for (auto it = m_priorities.begin(); it != m_priorities.end(); ++it) {
-				auto queue = it->second;
-				elemCount += queue.size();
-			}
-			return elemCount;
+			return m_size;
 		}
 
 		/**
@@ -49,19 +47,18 @@ template <class T> class PriorityQueue {
 		T
 		pop()
 		{
-			// std::cout << "Pop element, number of queues is " << m_priorities.size() << std::endl;
-			for (auto it = m_priorities.begin(); it != m_priorities.end(); ++it) {
-				auto queue = it->second;
-				auto elem = queue.front();
-				queue.erase(queue.begin());
-				it->second = queue;
-				if (queue.empty()) {
-					// std::cout << "Erase empty queue" << std::endl;
-					m_priorities.erase(it);
-				}
-				return elem;
+			if (m_size == 0) {
+				return T();
+			}
+
+			uint32_t priority = firstBucket();
+			Bucket& bucket = m_buckets[priority];
+			T elem = bucket.pop_front();
+			if (bucket.empty()) {
+				m_nonEmpty[priority / 64] &= ~(uint64_t(1) << (priority % 64));
 			}
-			return T();
+			m_size--;
+			return elem;
 		}
 
 		/**
@@ -70,12 +67,115 @@ template <class T> class PriorityQueue {
 		T
 		top() const
 		{
-			for (auto it = m_priorities.begin(); it != m_priorities.end(); ++it) {
-				auto queue = it->second;
-				auto elem = queue.front();
-				return elem;
+			if (m_size == 0) {
+				return T();
 			}
-			return T();
+			return m_buckets[firstBucket()].front();
+		}
+
+		/**
+		 * \brief Returns the largest priority value with queued elements, the queue must not be empty
+		 */
+		uint32_t
+		lastPriority() const
+		{
+			return lastBucket();
+		}
+
+		/**
+		 * Removes the most recently added element of the lowest priority class from the queue
+		 */
+		T
+		popBack()
+		{
+			if (m_size == 0) {
+				return T();
+			}
+
+			uint32_t priority = lastBucket();
+			Bucket& bucket = m_buckets[priority];
+			T elem = bucket.pop_back();
+			if (bucket.empty()) {
+				m_nonEmpty[priority / 64] &= ~(uint64_t(1) << (priority % 64));
+			}
+			m_size--;
+			return elem;
+		}
+
+		/**
+		 * \brief Returns the smallest priority of at least the given one with queued elements, Buckets if there is none
+		 */
+		uint32_t
+		nextPriority(uint32_t priority) const
+		{
+			if (priority >= Buckets) {
+				return Buckets;
+			}
+			uint32_t word = priority / 64;
+			uint64_t bits = m_nonEmpty[word] & (~uint64_t(0) << (priority % 64));
+			while (bits == 0) {
+				if (++word == WORDS) {
+					return Buckets;
+				}
+				bits = m_nonEmpty[word];
+			}
+			return word * 64 + __builtin_ctzll(bits);
+		}
+
+		/**
+		 * \brief Removes the oldest element of the given priority, which must have queued elements
+		 */
+		T
+		pop(uint32_t priority)
+		{
+			priority = clamp(priority);
+			Bucket& bucket = m_buckets[priority];
+			T elem = bucket.pop_front();
+			if (bucket.empty()) {
+				m_nonEmpty[priority / 64] &= ~(uint64_t(1) << (priority % 64));
+			}
+			m_size--;
+			return elem;
+		}
+
+		/**
+		 * \brief Returns the number of elements of the given priority
+		 */
+		uint32_t
+		size(uint32_t priority) const
+		{
+			return m_buckets[clamp(priority)].size();
+		}
+
+		/**
+		 * \brief Returns an element of the given priority, index 0 is the oldest
+		 */
+		const T&
+		at(uint32_t priority, uint32_t index) const
+		{
+			return m_buckets[clamp(priority)].at(index);
+		}
+
+		/**
+		 * \brief Removes the oldest elements of the given priority which match a predicate
+		 *
+		 * Linear in the number of elements of the priority, however many are removed.
+		 *
+		 * @param count Maximum number of elements to remove
+		 * @param erased Receives the removed elements, oldest first
+		 */
+		template <class Predicate>
+		void
+		eraseOldest(uint32_t priority, uint32_t count, Predicate predicate, std::vector<T>& erased)
+		{
+			priority = clamp(priority);
+			Bucket& bucket = m_buckets[priority];
+			uint32_t before = erased.size();
+			bucket.eraseOldest(count, predicate, erased);
+			if (bucket.empty()) {
+				m_nonEmpty[priority / 64] &= ~(uint64_t(1) << (priority % 64));
+			}
+			m_size -= erased.size() - before;
 		}
 
 		/**
@@ -87,39 +187,162 @@ template <class T> class PriorityQueue {
 		void
 		push(T elem, uint32_t priority)
 		{
-			bool priorityFound = false;
-			// std::cout << "insert element in queue, priority " << priority << std::endl;
-			for (auto it = m_priorities.begin(); it != m_priorities.end(); ++it) {
-
-				uint32_t queue_prio = it->first;
-				if (queue_prio == priority) {
-					// std::cout << "queue with priority " << priority << " found" << std::endl;
-					priorityFound = true;
-					auto queue = it->second;
-					queue.push_back(elem);
-					it->second = queue;
-					break;
+			priority = clamp(priority);
+			m_buckets[priority].push_back(elem);
+			m_nonEmpty[priority / 64] |= uint64_t(1) << (priority % 64);
+			m_size++;
+		}
+
+	protected:
+		static const uint32_t WORDS = Buckets / 64;
+
+		/**
+		 * \brief FIFO ring buffer holding the elements of one priority
+		 */
+		class Bucket {
+			public:
+				Bucket()
+					: m_head(0),
+					  m_count(0)
+				{
+				}
+
+				bool
+				empty() const
+				{
+					return m_count == 0;
+				}
+
+				uint32_t
+				size() const
+				{
+					return m_count;
+				}
+
+				const T&
+				front() const
+				{
+					return m_ring[m_head];
+				}
+
+				const T&
+				at(uint32_t index) const
+				{
+					return m_ring[(m_head + index) & (m_ring.size() - 1)];
+				}
+
+				void
+				push_back(const T& elem)
+				{
+					if (m_count == m_ring.size()) {
+						grow();
+					}
+					m_ring[(m_head + m_count) & (m_ring.size() - 1)] = elem;
+					m_count++;
 				}
-			}
 
-			if (!priorityFound) {
-				// std::cout << "Priority " << priority << " not found, create new queue found" << std::endl;
-				std::vector< T > queue;
-				queue.push_back(elem);
-				std::pair <uint32_t, std::vector< T > > queuePair(priority, queue);
-				m_priorities.push_back(queuePair);
+				T
+				pop_front()
+				{
+					T elem = m_ring[m_head];
+					m_ring[m_head] = T();
+					m_head = (m_head + 1) & (m_ring.size() - 1);
+					m_count--;
+					return elem;
+				}
+
+				template <class Predicate>
+				void
+				eraseOldest(uint32_t count, Predicate predicate, std::vector<T>& erased)
+				{
+					// Move the kept elements forward over the removed ones in a single pass
+					uint32_t mask = m_ring.size() - 1;
+					uint32_t kept = 0;
+					for (uint32_t i = 0; i < m_count; i++) {
+						T& elem = m_ring[(m_head + i) & mask];
+						if (count > 0 && predicate(elem)) {
+							erased.push_back(elem);
+							count--;
+						} else {
+							if (kept != i) {
+								m_ring[(m_head + kept) & mask] = elem;
+							}
+							kept++;
+						}
+					}
+					for (uint32_t i = kept; i < m_count; i++) {
+						m_ring[(m_head + i) & mask] = T();
+					}
+					m_count = kept;
+				}
+
+				T
+				pop_back()
+				{
+					uint32_t last = (m_head + m_count - 1) & (m_ring.size() - 1);
+					T elem = m_ring[last];
+					m_ring[last] = T();
+					m_count--;
+					return elem;
+				}
+
+			private:
+				void
+				grow()
+				{
+					std::vector< T > ring(m_ring.empty() ? 8 : 2 * m_ring.size());
+					for (uint32_t i = 0; i < m_count; i++) {
+						ring[i] = m_ring[(m_head + i) & (m_ring.size() - 1)];
+					}
+					m_ring.swap(ring);
+					m_head = 0;
+				}
 
-				std::sort(m_priorities.begin(), m_priorities.end(), queue_comparator<T>());
+				std::vector< T > m_ring;
+				uint32_t m_head;
+				uint32_t m_count;
+		};
+
+		/**
+		 * \brief Maps priorities of Buckets or more to the last bucket
+		 */
+		static uint32_t
+		clamp(uint32_t priority)
+		{
+			return priority < Buckets ? priority : Buckets - 1;
+		}
+
+		/**
+		 * \brief Returns the smallest priority with queued elements, the queue must not be empty
+		 */
+		uint32_t
+		firstBucket() const
+		{
+			uint32_t word = 0;
+			while (m_nonEmpty[word] == 0) {
+				word++;
 			}
-			// std::cout << m_priorities.size() << " queues after insert" << std::endl;
-			// std::cout << "Queue Size " << size() << std::endl;
+			return word * 64 + __builtin_ctzll(m_nonEmpty[word]);
 		}
 
-	protected:
-		std::vector< std::pair <uint32_t, std::vector< T > > > m_priorities;
+		/**
+		 * \brief Returns the largest priority with queued elements, the queue must not be empty
+		 */
+		uint32_t
+		lastBucket() const
+		{
+			uint32_t word = WORDS - 1;
+			while (m_nonEmpty[word] == 0) {
+				word--;
+			}
+			return word * 64 + 63 - __builtin_clzll(m_nonEmpty[word]);
+		}
 
+		Bucket m_buckets[Buckets];
+		uint64_t m_nonEmpty[WORDS];
+		uint32_t m_size;
 
-}; 
 
-#endif
+};
 
+#endif
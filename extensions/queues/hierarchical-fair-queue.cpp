@@ -0,0 +1,473 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2007 University of Washington
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/log.h"
+#include "ns3/enum.h"
+#include "ns3/uinteger.h"
+#include "ns3/string.h"
+#include "ns3/boolean.h"
+#include "ns3/pointer.h"
+#include "ns3/simulator.h"
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+#include "hierarchical-fair-queue.hpp"
+#include "class-list.hpp"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("HierarchicalFairQueue");
+
+NS_OBJECT_ENSURE_REGISTERED (HierarchicalFairQueue);
+
+const uint32_t HierarchicalFairQueue::WORDS;
+
+TypeId HierarchicalFairQueue::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::HierarchicalFairQueue")
+    .SetParent<Queue> ()
+    .SetGroupName("Network")
+    .AddConstructor<HierarchicalFairQueue> ()
+    .AddAttribute ("Mode",
+                   "Whether to use bytes (see MaxBytes) or packets (see MaxPackets) as the maximum queue size metric.",
+                   EnumValue (QUEUE_MODE_PACKETS),
+                   MakeEnumAccessor (&HierarchicalFairQueue::SetMode,
+                                     &HierarchicalFairQueue::GetMode),
+                   MakeEnumChecker (QUEUE_MODE_BYTES, "QUEUE_MODE_BYTES",
+                                    QUEUE_MODE_PACKETS, "QUEUE_MODE_PACKETS"))
+    .AddAttribute ("MaxPackets",
+                   "The maximum number of packets accepted by this HierarchicalFairQueue.",
+                   UintegerValue (100),
+                   MakeUintegerAccessor (&HierarchicalFairQueue::m_maxPackets),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("MaxBytes",
+                   "The maximum number of bytes accepted by this HierarchicalFairQueue.",
+                   UintegerValue (100 * 1024),
+                   MakeUintegerAccessor (&HierarchicalFairQueue::m_maxBytes),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("StrictPriority",
+                   "Whether QCI classes are served by strict priority instead of by weight.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&HierarchicalFairQueue::SetStrictPriority,
+                                        &HierarchicalFairQueue::GetStrictPriority),
+                   MakeBooleanChecker ())
+    .AddAttribute ("Quantum",
+                   "The bytes a flow may send per round within its class.",
+                   UintegerValue (1500),
+                   MakeUintegerAccessor (&HierarchicalFairQueue::m_quantum),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("RateCapBurst",
+                   "The bytes a rate capped class may send at once after being idle.",
+                   UintegerValue (10 * 1500),
+                   MakeUintegerAccessor (&HierarchicalFairQueue::m_burst),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("ClassWeights",
+                   "Weights of QCI classes for weighted scheduling, e.g. \"20=50 90=10\", other classes weigh 100 - QCI.",
+                   StringValue (""),
+                   MakeStringAccessor (&HierarchicalFairQueue::SetClassWeights,
+                                       &HierarchicalFairQueue::GetClassWeights),
+                   MakeStringChecker ())
+    .AddAttribute ("RateCaps",
+                   "Rate caps of QCI classes for strict priority scheduling, e.g. \"20=200kbps\".",
+                   StringValue (""),
+                   MakeStringAccessor (&HierarchicalFairQueue::SetRateCaps,
+                                       &HierarchicalFairQueue::GetRateCaps),
+                   MakeStringChecker ())
+    .AddAttribute ("Classifier",
+                   "Rules for separating traffic flows by name prefix, e.g. \"/=2 /video=4\" (see ndn::FlowClassifier::setRules).",
+                   StringValue (""),
+                   MakeStringAccessor (&HierarchicalFairQueue::SetClassifier,
+                                       &HierarchicalFairQueue::GetClassifier),
+                   MakeStringChecker ())
+    .AddAttribute ("SojournStats",
+                   "The sojourn time histograms of the packets leaving this queue, per QCI class and traffic flow.",
+                   TypeId::ATTR_GET,
+                   PointerValue (),
+                   MakePointerAccessor (&HierarchicalFairQueue::m_sojournStats),
+                   MakePointerChecker<SojournStats> ())
+  ;
+
+  return tid;
+}
+
+HierarchicalFairQueue::HierarchicalFairQueue () :
+  Queue (),
+  m_virtualTime (0),
+  m_selected (FlowTable::INVALID_FLOW),
+  m_strictPriority (false),
+  m_bytesInQueue (0),
+  m_packetsInQueue (0)
+{
+  NS_LOG_FUNCTION (this);
+  m_sojournStats = CreateObject<SojournStats> ();
+
+  for (uint32_t qci = 0; qci < m_classes.size(); qci++) {
+    ClassState& cls = m_classes[qci];
+    cls.packets = 0;
+    cls.weight = qci < 99 ? 100 - qci : 1;
+    cls.finish = 0;
+    cls.rateCap = 0;
+    cls.tokens = 0;
+  }
+  for (uint32_t i = 0; i < WORDS; i++) {
+    m_nonEmpty[i] = 0;
+  }
+}
+
+HierarchicalFairQueue::~HierarchicalFairQueue ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+HierarchicalFairQueue::SetMode (HierarchicalFairQueue::QueueMode mode)
+{
+  NS_LOG_FUNCTION (this << mode);
+  m_mode = mode;
+}
+
+HierarchicalFairQueue::QueueMode
+HierarchicalFairQueue::GetMode (void) const
+{
+  NS_LOG_FUNCTION (this);
+  return m_mode;
+}
+
+void
+HierarchicalFairQueue::SetClassifier (std::string rules)
+{
+  NS_LOG_FUNCTION (this << rules);
+  m_classifier.setRules(rules);
+}
+
+std::string
+HierarchicalFairQueue::GetClassifier (void) const
+{
+  return m_classifier.getRules();
+}
+
+void
+HierarchicalFairQueue::SetStrictPriority (bool strict)
+{
+  NS_LOG_FUNCTION (this << strict);
+  NS_ASSERT_MSG (m_packetsInQueue == 0, "Scheduling cannot change while packets are queued");
+  m_strictPriority = strict;
+}
+
+bool
+HierarchicalFairQueue::GetStrictPriority (void) const
+{
+  return m_strictPriority;
+}
+
+void
+HierarchicalFairQueue::SetClassWeight (uint32_t qci, uint32_t weight)
+{
+  NS_LOG_FUNCTION (this << qci << weight);
+  NS_ASSERT_MSG (qci < m_classes.size(), "QCI class out of range");
+  NS_ASSERT_MSG (weight > 0, "Class weight must be positive");
+  NS_ASSERT_MSG (m_classes[qci].packets == 0, "Weight cannot change while packets of the class are queued");
+  m_classes[qci].weight = weight;
+}
+
+uint32_t
+HierarchicalFairQueue::GetClassWeight (uint32_t qci) const
+{
+  return qci < m_classes.size() ? m_classes[qci].weight : 0;
+}
+
+void
+HierarchicalFairQueue::SetRateCap (uint32_t qci, DataRate rate)
+{
+  NS_LOG_FUNCTION (this << qci);
+  NS_ASSERT_MSG (qci < m_classes.size(), "QCI class out of range");
+  ClassState& cls = m_classes[qci];
+  cls.rateCap = rate.GetBitRate();
+  cls.tokens = m_burst;
+  cls.lastRefill = Simulator::Now();
+  m_selected = FlowTable::INVALID_FLOW;
+}
+
+DataRate
+HierarchicalFairQueue::GetRateCap (uint32_t qci) const
+{
+  return DataRate(qci < m_classes.size() ? m_classes[qci].rateCap : 0);
+}
+
+void
+HierarchicalFairQueue::SetClassWeights (std::string weights)
+{
+  NS_LOG_FUNCTION (this << weights);
+
+  std::vector<uint32_t> values(m_classes.size());
+  for (uint32_t qci = 0; qci < values.size(); qci++) {
+    values[qci] = qci < 99 ? 100 - qci : 1;
+  }
+  for (const auto& entry : parseClassList(weights)) {
+    size_t parsed = 0;
+    unsigned long weight = 0;
+    try {
+      weight = std::stoul(entry.second, &parsed);
+    } catch (const std::logic_error&) {
+      parsed = 0;
+    }
+    if (parsed != entry.second.size() || weight == 0) {
+      throw std::invalid_argument("Class weight `" + entry.second + "` is not a positive number");
+    }
+    values[entry.first] = weight;
+  }
+
+  for (uint32_t qci = 0; qci < values.size(); qci++) {
+    if (m_classes[qci].weight != values[qci]) {
+      SetClassWeight(qci, values[qci]);
+    }
+  }
+  m_classWeights = weights;
+}
+
+std::string
+HierarchicalFairQueue::GetClassWeights (void) const
+{
+  return m_classWeights;
+}
+
+void
+HierarchicalFairQueue::SetRateCaps (std::string caps)
+{
+  NS_LOG_FUNCTION (this << caps);
+
+  std::vector<DataRate> rates(m_classes.size(), DataRate(0));
+  for (const auto& entry : parseClassList(caps)) {
+    std::istringstream value (entry.second);
+    value >> rates[entry.first];
+    if (value.fail()) {
+      throw std::invalid_argument("Rate cap `" + entry.second + "` is not a data rate");
+    }
+  }
+
+  for (uint32_t qci = 0; qci < rates.size(); qci++) {
+    if (m_classes[qci].rateCap != rates[qci].GetBitRate()) {
+      SetRateCap(qci, rates[qci]);
+    }
+  }
+  m_rateCaps = caps;
+}
+
+std::string
+HierarchicalFairQueue::GetRateCaps (void) const
+{
+  return m_rateCaps;
+}
+
+uint32_t
+HierarchicalFairQueue::GetNFlows (void) const
+{
+  return m_flows.size();
+}
+
+uint32_t
+HierarchicalFairQueue::GetNQciPackets (uint32_t qci) const
+{
+  return qci < m_classes.size() ? m_classes[qci].packets : 0;
+}
+
+bool
+HierarchicalFairQueue::DoEnqueue (Ptr<Packet> p)
+{
+  NS_LOG_FUNCTION (this << p);
+
+  ndn::FlowInfo info = m_classifier.classify(p);
+  uint32_t qci = info.qci;
+
+  NS_LOG_DEBUG("Queuing packet of flow " << info.flowKey << " in QCI " << qci);
+
+  if (m_mode == QUEUE_MODE_PACKETS && (m_packetsInQueue >= m_maxPackets))
+    {
+      NS_LOG_LOGIC ("Queue full (at max packets) -- droppping pkt");
+      Drop (p);
+      return false;
+    }
+
+  if (m_mode == QUEUE_MODE_BYTES && (m_bytesInQueue + p->GetSize () >= m_maxBytes))
+    {
+      NS_LOG_LOGIC ("Queue full (packet would exceed max bytes) -- droppping pkt");
+      Drop (p);
+      return false;
+    }
+
+  m_bytesInQueue += p->GetSize ();
+  m_packetsInQueue++;
+
+  // Packets of one prefix in different classes belong to different flows
+  uint64_t flowKey = info.flowKey ^ (uint64_t (qci) * 0x9e3779b97f4a7c15ULL);
+  bool isNew = false;
+  uint32_t flowId = m_flows.intern(flowKey, isNew);
+  if (flowId >= m_queues.size()) {
+    m_queues.resize(flowId + 1);
+    m_drr.resize(flowId + 1);
+  }
+
+  ClassState& cls = m_classes[qci];
+  m_queues[flowId].push_back(p, qci, info.flowKey, Simulator::Now());
+  if (isNew) {
+    m_drr.activate(cls.round, flowId, m_quantum, m_queues);
+  }
+
+  // A class enters the outer schedule with its first packet
+  if (cls.packets++ == 0) {
+    m_selected = FlowTable::INVALID_FLOW;
+    if (m_strictPriority) {
+      m_nonEmpty[qci / 64] |= uint64_t (1) << (qci % 64);
+    } else {
+      m_schedule.push(qci, std::max(m_virtualTime, cls.finish));
+    }
+  }
+
+  NS_LOG_LOGIC ("Number packets " << m_packetsInQueue);
+  NS_LOG_LOGIC ("Number bytes " << m_bytesInQueue);
+  NS_LOG_LOGIC ("Number of queues " << m_flows.size());
+
+  return true;
+}
+
+Ptr<Packet>
+HierarchicalFairQueue::DoDequeue (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  if (m_packetsInQueue == 0)
+  {
+    NS_LOG_LOGIC ("Queue empty");
+    return 0;
+  }
+
+  Time now = Simulator::Now();
+  uint32_t qci = selectClass(now);
+  m_selected = FlowTable::INVALID_FLOW;
+  ClassState& cls = m_classes[qci];
+
+  // Inner level, the first flow of the class can afford its head packet
+  uint32_t flowId = cls.round.first;
+  FlowRing& queue = m_queues[flowId];
+  uint32_t bytes = queue.bytes(0);
+  m_drr.charge(flowId, bytes);
+  m_sojournStats->Record(qci, queue.flowKey(0), now - queue.enqueueTime(0));
+  Ptr<Packet> p = queue.pop_front();
+
+  if (queue.empty()) {
+    NS_LOG_LOGIC("Erase queue for flow " << m_flows.getKey(flowId));
+    m_flows.release(flowId);
+    m_drr.removeFirst(cls.round);
+  }
+  m_drr.advance(cls.round, m_queues);
+  cls.packets--;
+
+  // Outer level
+  // A class served beyond its cap goes into debt and pays it back first
+  if (cls.rateCap > 0) {
+    cls.tokens = availableTokens(qci, now) - bytes;
+    cls.lastRefill = now;
+  }
+  if (m_strictPriority) {
+    if (cls.packets == 0) {
+      m_nonEmpty[qci / 64] &= ~(uint64_t (1) << (qci % 64));
+    }
+  } else {
+    m_virtualTime = m_schedule.topKey();
+    cls.finish = m_virtualTime + bytes * VIRTUAL_TIME_PER_BYTE / cls.weight;
+    if (cls.packets > 0) {
+      m_schedule.update(qci, cls.finish);
+    } else {
+      m_schedule.pop();
+    }
+  }
+
+  m_bytesInQueue -= p->GetSize ();
+  m_packetsInQueue--;
+
+  NS_LOG_LOGIC ("Popped " << p << " from QCI " << qci);
+
+  NS_LOG_LOGIC ("Number packets " << m_packetsInQueue);
+  NS_LOG_LOGIC ("Number bytes " << m_bytesInQueue);
+  NS_LOG_LOGIC ("Number of queues " << m_flows.size());
+
+  return p;
+}
+
+Ptr<const Packet>
+HierarchicalFairQueue::DoPeek (void) const
+{
+  NS_LOG_FUNCTION (this);
+
+  if (m_packetsInQueue == 0)
+    {
+      NS_LOG_LOGIC ("Queue empty");
+      return 0;
+    }
+
+  uint32_t qci = selectClass(Simulator::Now());
+  return m_queues[m_classes[qci].round.first].packet(0);
+}
+
+uint32_t
+HierarchicalFairQueue::selectClass(Time now) const
+{
+  if (m_selected == FlowTable::INVALID_FLOW || m_selectedAt != now) {
+    m_selected = doSelectClass(now);
+    m_selectedAt = now;
+  }
+  return m_selected;
+}
+
+uint32_t
+HierarchicalFairQueue::doSelectClass(Time now) const
+{
+  if (!m_strictPriority) {
+    return m_schedule.top();
+  }
+
+  // Smallest QCI value within its rate cap, or the smallest if all exceed their cap
+  uint32_t fallback = FlowTable::INVALID_FLOW;
+  for (uint32_t word = 0; word < WORDS; word++) {
+    uint64_t bits = m_nonEmpty[word];
+    while (bits != 0) {
+      uint32_t qci = word * 64 + __builtin_ctzll(bits);
+      const ClassState& cls = m_classes[qci];
+      if (cls.rateCap == 0 || availableTokens(qci, now) >= m_queues[cls.round.first].bytes(0)) {
+        return qci;
+      }
+      if (fallback == FlowTable::INVALID_FLOW) {
+        fallback = qci;
+      }
+      bits &= bits - 1;
+    }
+  }
+  return fallback;
+}
+
+double
+HierarchicalFairQueue::availableTokens(uint32_t qci, Time now) const
+{
+  const ClassState& cls = m_classes[qci];
+  double refill = cls.rateCap / 8.0 * (now - cls.lastRefill).GetSeconds();
+  return std::min((double)m_burst, cls.tokens + refill);
+}
+
+} // namespace ns3
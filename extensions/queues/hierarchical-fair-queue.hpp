@@ -0,0 +1,232 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2007 University of Washington
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef HIERARCHICALFAIRQUEUE_H
+#define HIERARCHICALFAIRQUEUE_H
+
+#include <array>
+#include <vector>
+#include <string>
+#include "ns3/packet.h"
+#include "ns3/queue.h"
+#include "ns3/nstime.h"
+#include "ns3/data-rate.h"
+
+#include "deficit-round-robin.hpp"
+#include "flow-classifier.hpp"
+#include "flow-ring.hpp"
+#include "flow-table.hpp"
+#include "indexed-heap.hpp"
+#include "sojourn-stats.hpp"
+
+namespace ns3 {
+
+/**
+ * \ingroup queue
+ *
+ * \brief A two level packet queue: QCI classes outside, fair queuing of traffic flows inside
+ *
+ * The outer level selects a QCI class, either
+ *  - by weight (default): start-time fair queuing over the classes, the
+ *    share of a class is proportional to its weight (see SetClassWeight), or
+ *  - by strict priority (StrictPriority attribute): the class with the
+ *    smallest QCI value is served first. A class can be limited to a rate
+ *    (see SetRateCap). While it exceeds that rate, it is only served if no
+ *    class within its rate has packets, so high priority traffic cannot starve
+ *    the other classes.
+ *
+ * Weights and rate caps are configured with the ClassWeights and RateCaps
+ * attributes, e.g. "20=50 90=10" and "20=200kbps".
+ *
+ * Inside a class, the traffic flows (separated by name prefix like in
+ * FairQueue) are served by Deficit Round Robin, so one greedy flow cannot
+ * starve the other flows of its class.
+ *
+ * Selecting the class costs O(log classes) with weights and O(1) with strict
+ * priority (plus the classes skipped because of their rate cap), selecting
+ * the flow within the class costs O(1).
+ */
+class HierarchicalFairQueue : public Queue {
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+  /**
+   * \brief HierarchicalFairQueue Constructor
+   *
+   * Creates a hierarchical queue with a maximum size of 100 packets by default
+   */
+  HierarchicalFairQueue ();
+
+  virtual ~HierarchicalFairQueue();
+
+  /**
+   * Set the operating mode of this device.
+   *
+   * \param mode The operating mode of this device.
+   *
+   */
+  void SetMode (HierarchicalFairQueue::QueueMode mode);
+
+  /**
+   * Get the encapsulation mode of this device.
+   *
+   * \returns The encapsulation mode of this device.
+   */
+  HierarchicalFairQueue::QueueMode GetMode (void) const;
+
+  /**
+   * \brief Sets the rules which separate traffic flows by name prefix
+   *
+   * \param rules Rules as accepted by ndn::FlowClassifier::setRules
+   */
+  void SetClassifier (std::string rules);
+
+  std::string GetClassifier (void) const;
+
+  /**
+   * \brief Selects strict priority or weighted scheduling of the classes
+   *
+   * Must not change while packets are queued.
+   */
+  void SetStrictPriority (bool strict);
+
+  bool GetStrictPriority (void) const;
+
+  /**
+   * \brief Sets the weight of a QCI class for weighted scheduling
+   *
+   * By default, a class weighs 100 - QCI (at least 1), like the priorities of WFQ.
+   * Must not change while packets of the class are queued.
+   */
+  void SetClassWeight (uint32_t qci, uint32_t weight);
+
+  uint32_t GetClassWeight (uint32_t qci) const;
+
+  /**
+   * \brief Sets the weights of the QCI classes from a list
+   *
+   * \param weights List of `qci=weight` entries separated by whitespace, `,`
+   * or `;`. Classes which are not listed get their default weight.
+   *
+   * \throw std::invalid_argument if an entry cannot be parsed
+   */
+  void SetClassWeights (std::string weights);
+
+  std::string GetClassWeights (void) const;
+
+  /**
+   * \brief Limits a QCI class to the given rate for strict priority scheduling
+   *
+   * \param qci The QCI class
+   * \param rate The rate cap, zero removes the cap
+   */
+  void SetRateCap (uint32_t qci, DataRate rate);
+
+  DataRate GetRateCap (uint32_t qci) const;
+
+  /**
+   * \brief Sets the rate caps of the QCI classes from a list
+   *
+   * \param caps List of `qci=rate` entries separated by whitespace, `,` or
+   * `;`, the rate takes the units of DataRate. Classes which are not listed
+   * are not capped.
+   *
+   * \throw std::invalid_argument if an entry cannot be parsed
+   */
+  void SetRateCaps (std::string caps);
+
+  std::string GetRateCaps (void) const;
+
+  /**
+   * \return The number of traffic flows that currently have packets in the queue
+   */
+  uint32_t GetNFlows (void) const;
+
+  /**
+   * \return The number of packets of the given QCI class in the queue
+   */
+  uint32_t GetNQciPackets (uint32_t qci) const;
+
+protected:
+  virtual bool DoEnqueue (Ptr<Packet> p);
+  virtual Ptr<Packet> DoDequeue (void);
+  virtual Ptr<const Packet> DoPeek (void) const;
+
+  /**
+   * \brief Selects the class to serve next, the queue must not be empty
+   *
+   * The selection is kept until the schedule changes or the time advances,
+   * so a Peek followed by a Dequeue selects only once.
+   */
+  uint32_t selectClass(Time now) const;
+
+  /**
+   * \brief Computes the class to serve next, see selectClass
+   */
+  uint32_t doSelectClass(Time now) const;
+
+  /**
+   * \brief Returns the bytes a rate capped class may send at the given time
+   */
+  double availableTokens(uint32_t qci, Time now) const;
+
+  /**
+   * \brief Scheduling state of a QCI class
+   */
+  struct ClassState
+  {
+    DeficitRoundRobin::Round round; //!< active flows of the class
+    uint32_t packets;       //!< packets of the class in the queue
+    uint32_t weight;        //!< weight for weighted scheduling
+    VirtualTime finish;     //!< virtual finishing time of the last served packet
+    uint64_t rateCap;       //!< rate cap in bit/s, 0 if not capped
+    double tokens;          //!< bytes the class may send at lastRefill, negative while in debt
+    Time lastRefill;        //!< time the tokens were updated last
+  };
+
+  static const uint32_t WORDS = ndn::FlowClassifier::QCI_BUCKETS / 64;
+
+  FlowTable m_flows;                  //!< dense ids of the traffic flows with queued packets
+  std::vector<FlowRing> m_queues;     //!< queues of all traffic flows, indexed by flow id
+  DeficitRoundRobin m_drr;            //!< deficit and active list link of every flow
+  std::array<ClassState, ndn::FlowClassifier::QCI_BUCKETS> m_classes; //!< state of every QCI class
+  uint64_t m_nonEmpty[WORDS];         //!< bitmap of classes with packets (strict priority)
+  IndexedHeap<VirtualTime> m_schedule; //!< classes with packets ordered by virtual start time (weights)
+  VirtualTime m_virtualTime;          //!< virtual start time of the packet served last (weights)
+  mutable uint32_t m_selected;        //!< class returned by selectClass, INVALID_FLOW after the schedule changed
+  mutable Time m_selectedAt;          //!< time m_selected was selected at, rate caps depend on it
+  ndn::FlowClassifier m_classifier;  //!< maps packets to traffic flows
+  Ptr<SojournStats> m_sojournStats;   //!< sojourn times of the dequeued packets
+  bool m_strictPriority;              //!< serve classes by strict priority instead of weights
+  std::string m_classWeights;         //!< weights as given to SetClassWeights
+  std::string m_rateCaps;             //!< rate caps as given to SetRateCaps
+  uint32_t m_quantum;                 //!< DRR quantum of the flows in bytes
+  uint32_t m_burst;                   //!< bucket size of rate capped classes in bytes
+  uint32_t m_maxPackets;              //!< max packets in the queue
+  uint32_t m_maxBytes;                //!< max bytes in the queue
+  uint32_t m_bytesInQueue;            //!< actual bytes in the queue
+  uint32_t m_packetsInQueue;          //!< actual packets in the queue
+  QueueMode m_mode;                   //!< queue mode (packets or bytes limited)
+};
+
+} // namespace ns3
+
+#endif /* HIERARCHICALFAIRQUEUE_H */
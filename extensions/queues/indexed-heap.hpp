@@ -0,0 +1,232 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef INDEXEDHEAP_H
+#define INDEXEDHEAP_H
+
+#include <stddef.h>
+#include <inttypes.h>
+#include <utility>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \brief Binary min-heap over dense ids with an index from ids to heap positions
+ *
+ * Every id is contained at most once. Besides accessing the id with the
+ * smallest key, the index allows changing the key of, or removing, any
+ * contained id in O(log n). The fair queues keep one entry per active flow id,
+ * keyed by the virtual finish time of the flow's head packet.
+ *
+ * The index is a flat array, so ids should be small integers such as the
+ * ids handed out by FlowTable.
+ */
+template <typename Key>
+class IndexedHeap
+{
+public:
+  bool
+  empty () const
+  {
+    return m_heap.empty ();
+  }
+
+  size_t
+  size () const
+  {
+    return m_heap.size ();
+  }
+
+  bool
+  contains (uint32_t id) const
+  {
+    return id < m_position.size () && m_position[id] != NPOS;
+  }
+
+  /**
+   * \brief Returns the id with the smallest key, the heap must not be empty
+   */
+  uint32_t
+  top () const
+  {
+    return m_heap.front ().id;
+  }
+
+  /**
+   * \brief Returns the smallest key, the heap must not be empty
+   */
+  const Key&
+  topKey () const
+  {
+    return m_heap.front ().key;
+  }
+
+  /**
+   * \brief Adds an id which is not yet contained in the heap
+   */
+  void
+  push (uint32_t id, const Key& key)
+  {
+    if (id >= m_position.size ())
+      {
+        m_position.resize (id + 1, NPOS);
+      }
+    m_heap.push_back (Entry (id, key));
+    m_position[id] = m_heap.size () - 1;
+    siftUp (m_heap.size () - 1);
+  }
+
+  /**
+   * \brief Changes the key of a contained id
+   */
+  void
+  update (uint32_t id, const Key& key)
+  {
+    size_t pos = m_position[id];
+    bool decreased = key < m_heap[pos].key;
+    m_heap[pos].key = key;
+    if (decreased)
+      {
+        siftUp (pos);
+      }
+    else
+      {
+        siftDown (pos);
+      }
+  }
+
+  /**
+   * \brief Removes the id with the smallest key, the heap must not be empty
+   */
+  void
+  pop ()
+  {
+    erase (top ());
+  }
+
+  /**
+   * \brief Removes a contained id
+   */
+  void
+  erase (uint32_t id)
+  {
+    size_t pos = m_position[id];
+    m_position[id] = NPOS;
+
+    size_t last = m_heap.size () - 1;
+    if (pos != last)
+      {
+        m_heap[pos] = std::move (m_heap[last]);
+        m_position[m_heap[pos].id] = pos;
+        m_heap.pop_back ();
+        if (pos > 0 && m_heap[pos].key < m_heap[(pos - 1) / 2].key)
+          {
+            siftUp (pos);
+          }
+        else
+          {
+            siftDown (pos);
+          }
+      }
+    else
+      {
+        m_heap.pop_back ();
+      }
+  }
+
+  void
+  clear ()
+  {
+    for (const Entry& entry : m_heap)
+      {
+        m_position[entry.id] = NPOS;
+      }
+    m_heap.clear ();
+  }
+
+private:
+  static const size_t NPOS = static_cast<size_t> (-1);
+
+  struct Entry
+  {
+    Entry (uint32_t id, const Key& key)
+      : id (id),
+        key (key)
+    {
+    }
+
+    uint32_t id;
+    Key key;
+  };
+
+  void
+  siftUp (size_t pos)
+  {
+    Entry entry = std::move (m_heap[pos]);
+    while (pos > 0)
+      {
+        size_t parent = (pos - 1) / 2;
+        if (!(entry.key < m_heap[parent].key))
+          {
+            break;
+          }
+        m_heap[pos] = std::move (m_heap[parent]);
+        m_position[m_heap[pos].id] = pos;
+        pos = parent;
+      }
+    m_heap[pos] = std::move (entry);
+    m_position[m_heap[pos].id] = pos;
+  }
+
+  void
+  siftDown (size_t pos)
+  {
+    Entry entry = std::move (m_heap[pos]);
+    size_t count = m_heap.size ();
+    while (true)
+      {
+        size_t child = 2 * pos + 1;
+        if (child >= count)
+          {
+            break;
+          }
+        if (child + 1 < count && m_heap[child + 1].key < m_heap[child].key)
+          {
+            child++;
+          }
+        if (!(m_heap[child].key < entry.key))
+          {
+            break;
+          }
+        m_heap[pos] = std::move (m_heap[child]);
+        m_position[m_heap[pos].id] = pos;
+        pos = child;
+      }
+    m_heap[pos] = std::move (entry);
+    m_position[m_heap[pos].id] = pos;
+  }
+
+  std::vector<Entry> m_heap;        //!< heap ordered entries
+  std::vector<size_t> m_position;   //!< heap position of every id, NPOS if not contained
+};
+
+template <typename Key>
+const size_t IndexedHeap<Key>::NPOS;
+
+} // namespace ns3
+
+#endif /* INDEXEDHEAP_H */
@@ -0,0 +1,474 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2007 University of Washington
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/log.h"
+#include "ns3/uinteger.h"
+#include "ns3/pointer.h"
+#include "ns3/simulator.h"
+#include "ns3/callback.h"
+#include "ns3/trace-source-accessor.h"
+
+#include <ndn-cxx/encoding/tlv.hpp>
+#include <ndn-cxx/name.hpp>
+
+#include <algorithm>
+#include <string>
+
+#include "interest-shaper-queue.hpp"
+#include "fair-queue.hpp"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("InterestShaperQueue");
+
+NS_OBJECT_ENSURE_REGISTERED (InterestShaperQueue);
+
+namespace {
+
+/**
+ * \brief Push rates registered by the producers, shared by all shapers
+ */
+struct PushRates
+{
+  std::unordered_map<uint64_t, double> rates; //!< bytes per second by flow key of the prefix
+  std::string rules;                          //!< classifier rules separating the registered prefixes
+  uint32_t version = 0;                       //!< incremented on every registration
+  bool resetScheduled = false;                //!< whether resetPushRates runs when the simulation is destroyed
+};
+
+PushRates&
+getPushRates ()
+{
+  static PushRates pushRates;
+  return pushRates;
+}
+
+/**
+ * \brief Clears the registrations, so the next simulation in the process starts without them
+ */
+void
+resetPushRates ()
+{
+  PushRates& pushRates = getPushRates ();
+  pushRates.rates.clear();
+  pushRates.rules.clear();
+  pushRates.version++;
+  pushRates.resetScheduled = false;
+}
+
+} // namespace
+
+TypeId InterestShaperQueue::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::InterestShaperQueue")
+    .SetParent<Queue> ()
+    .SetGroupName("Network")
+    .AddConstructor<InterestShaperQueue> ()
+    .AddAttribute ("Queue",
+                   "The queue of the released Interests and all other packets, a FairQueue if not set.",
+                   PointerValue (),
+                   MakePointerAccessor (&InterestShaperQueue::m_queue),
+                   MakePointerChecker<Queue> ())
+    .AddAttribute ("ReverseRate",
+                   "The rate of the link carrying the Data back, 0 disables shaping.",
+                   DataRateValue (DataRate (0)),
+                   MakeDataRateAccessor (&InterestShaperQueue::m_reverseRate),
+                   MakeDataRateChecker ())
+    .AddAttribute ("DataSize",
+                   "The expected size in bytes of the Data returned for a regular Interest.",
+                   UintegerValue (1100),
+                   MakeUintegerAccessor (&InterestShaperQueue::m_dataSize),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("Burst",
+                   "The size of the token bucket in bytes of Data.",
+                   UintegerValue (10 * 1100),
+                   MakeUintegerAccessor (&InterestShaperQueue::m_burst),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("MaxInterests",
+                   "The maximum number of Interests held by the shaper.",
+                   UintegerValue (100),
+                   MakeUintegerAccessor (&InterestShaperQueue::m_maxInterests),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("PushHoldTime",
+                   "The time a PI reserves its Data rate unless it is refreshed.",
+                   TimeValue (Seconds (5)),
+                   MakeTimeAccessor (&InterestShaperQueue::m_pushHoldTime),
+                   MakeTimeChecker ())
+    .AddAttribute ("SojournStats",
+                   "The time the released Interests were held by the shaper, per QCI class and PI stream (regular Interests have flow key 0). The time in the inner queue is recorded by its own SojournStats.",
+                   TypeId::ATTR_GET,
+                   PointerValue (),
+                   MakePointerAccessor (&InterestShaperQueue::m_sojournStats),
+                   MakePointerChecker<SojournStats> ())
+    .AddTraceSource ("Wake",
+                     "A held Interest is eligible, or the inner queue may send a held packet, after the device found no packet to send.",
+                     MakeTraceSourceAccessor (&InterestShaperQueue::m_wakeTrace),
+                     "ns3::InterestShaperQueue::WakeTracedCallback")
+  ;
+
+  return tid;
+}
+
+InterestShaperQueue::InterestShaperQueue () :
+  Queue (),
+  m_rulesVersion (0),
+  m_tokens (0),
+  m_reservedRate (0),
+  m_nextExpiry (Time::Max ()),
+  m_busy (false),
+  m_waking (false)
+{
+  NS_LOG_FUNCTION (this);
+  m_sojournStats = CreateObject<SojournStats> ();
+}
+
+InterestShaperQueue::~InterestShaperQueue ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+InterestShaperQueue::NotifyConstructionCompleted (void)
+{
+  NS_LOG_FUNCTION (this);
+  if (m_queue == 0)
+    {
+      m_queue = CreateObject<FairQueue> ();
+    }
+  // Inner queues which hold packets back wake the device through the shaper
+  m_queue->TraceConnectWithoutContext ("Wake", MakeCallback (&InterestShaperQueue::innerWake, this));
+  Queue::NotifyConstructionCompleted ();
+}
+
+void
+InterestShaperQueue::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  Simulator::Cancel (m_wakeEvent);
+  m_woken = 0;
+  m_restart = 0;
+  Queue::DoDispose ();
+}
+
+void
+InterestShaperQueue::SetPushRate (const ::ndn::Name& prefix, double bytesPerSecond)
+{
+  NS_LOG_FUNCTION (prefix.toUri () << bytesPerSecond);
+  PushRates& pushRates = getPushRates ();
+  if (!pushRates.resetScheduled) {
+    Simulator::ScheduleDestroy (&resetPushRates);
+    pushRates.resetScheduled = true;
+  }
+  uint64_t flowKey = ndn::FlowClassifier::flowKey(prefix);
+  if (pushRates.rates.find(flowKey) == pushRates.rates.end()) {
+    pushRates.rules += prefix.toUri() + "=" + std::to_string(prefix.size()) + " ";
+  }
+  pushRates.rates[flowKey] = bytesPerSecond;
+  pushRates.version++;
+}
+
+uint32_t
+InterestShaperQueue::GetNHeldInterests (void) const
+{
+  return m_interests.size();
+}
+
+double
+InterestShaperQueue::GetReservedRate (void) const
+{
+  return m_reservedRate;
+}
+
+double
+InterestShaperQueue::getCapacity (void) const
+{
+  return m_reverseRate.GetBitRate() / 8.0;
+}
+
+void
+InterestShaperQueue::refill (Time now)
+{
+  double rate = std::max(getCapacity() - m_reservedRate, 0.0);
+  m_tokens = std::min(m_tokens + rate * (now - m_lastRefill).GetSeconds(), static_cast<double>(m_burst));
+  m_lastRefill = now;
+}
+
+void
+InterestShaperQueue::expireReservations (Time now)
+{
+  if (now < m_nextExpiry) {
+    return;
+  }
+
+  // Sum up the remaining reservations again instead of subtracting, which keeps
+  // rounding errors from adding up
+  m_reservedRate = 0;
+  m_nextExpiry = Time::Max();
+  for (auto reservation = m_reservations.begin(); reservation != m_reservations.end();) {
+    if (reservation->second.expires <= now) {
+      NS_LOG_LOGIC("PI reservation of " << reservation->second.rate << " B/s expired");
+      reservation = m_reservations.erase(reservation);
+    }
+    else {
+      m_reservedRate += reservation->second.rate;
+      m_nextExpiry = std::min(m_nextExpiry, reservation->second.expires);
+      ++reservation;
+    }
+  }
+}
+
+bool
+InterestShaperQueue::isEligible (const HeldInterest& interest, Time now) const
+{
+  if (interest.pushRate == 0) {
+    double rate = std::max(getCapacity() - m_reservedRate, 0.0);
+    double tokens = std::min(m_tokens + rate * (now - m_lastRefill).GetSeconds(), static_cast<double>(m_burst));
+    // An Interest whose Data exceeds the bucket waits for a full bucket
+    return tokens >= std::min(m_dataSize, m_burst);
+  }
+
+  auto reservation = m_reservations.find(interest.flowKey);
+  if (reservation != m_reservations.end() && reservation->second.expires > now) {
+    return true;
+  }
+  // A stream faster than the reverse link still gets through on an otherwise free link
+  return m_reservedRate == 0 || m_reservedRate + interest.pushRate <= getCapacity();
+}
+
+void
+InterestShaperQueue::release (Time now, bool force)
+{
+  refill(now);
+  expireReservations(now);
+
+  while (!m_interests.empty() && isEligible(m_interests.front(), now)) {
+    releaseFront(now);
+  }
+
+  // An idle device fails without a packet, so the Interest goes out into debt
+  while (force && !m_interests.empty() && m_queue->GetNPackets() == 0) {
+    NS_LOG_LOGIC("Inner queue empty, releasing Interest into debt");
+    releaseFront(now);
+  }
+}
+
+void
+InterestShaperQueue::releaseFront (Time now)
+{
+  HeldInterest interest = m_interests.front();
+  m_interests.pop_front();
+
+  if (!m_queue->Enqueue(interest.packet)) {
+    NS_LOG_LOGIC("Inner queue full, dropping released Interest");
+    DropQueued(interest.packet);
+    return;
+  }
+  m_sojournStats->Record(interest.qci, interest.flowKey, now - interest.enqueueTime);
+
+  if (interest.pushRate == 0) {
+    // The debt of Interests released early is bounded, so they are not held for long afterwards
+    m_tokens = std::max(m_tokens - m_dataSize, -static_cast<double>(m_burst));
+    return;
+  }
+
+  Reservation reservation = {interest.pushRate, now + m_pushHoldTime};
+  auto result = m_reservations.insert(std::make_pair(interest.flowKey, reservation));
+  if (result.second) {
+    NS_LOG_LOGIC("PI reserves " << interest.pushRate << " B/s");
+    m_reservedRate += interest.pushRate;
+  }
+  else {
+    result.first->second.expires = reservation.expires;
+  }
+  m_nextExpiry = std::min(m_nextExpiry, reservation.expires);
+}
+
+bool
+InterestShaperQueue::DoEnqueue (Ptr<Packet> p)
+{
+  NS_LOG_FUNCTION (this << p);
+
+  if (p == m_woken) {
+    // The device sends the packet Wake handed out, it keeps its place at the head
+    m_woken = 0;
+    m_restart = p;
+    return true;
+  }
+
+  if (m_reverseRate.GetBitRate() != 0) {
+    const PushRates& pushRates = getPushRates();
+    if (m_rulesVersion != pushRates.version) {
+      m_classifier.setRules(pushRates.rules);
+      m_rulesVersion = pushRates.version;
+    }
+
+    ndn::FlowInfo info = m_classifier.classify(p);
+    if (info.type == ::ndn::tlv::Interest) {
+      if (m_interests.size() >= m_maxInterests) {
+        NS_LOG_LOGIC("Shaper full, dropping Interest");
+        Drop (p);
+        return false;
+      }
+
+      HeldInterest interest = {p, 0, 0.0, info.qci, Simulator::Now()};
+      if (info.push) {
+        auto rate = pushRates.rates.find(info.flowKey);
+        if (rate != pushRates.rates.end()) {
+          interest.flowKey = info.flowKey;
+          interest.pushRate = rate->second;
+        }
+      }
+      m_interests.push_back(interest);
+
+      NS_LOG_LOGIC ("Number of held Interests: " << m_interests.size());
+      return true;
+    }
+  }
+
+  if (!m_queue->Enqueue(p)) {
+    Drop (p);
+    return false;
+  }
+  return true;
+}
+
+Ptr<Packet>
+InterestShaperQueue::DoDequeue (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  m_woken = 0;
+  if (m_restart != 0) {
+    Ptr<Packet> p = m_restart;
+    m_restart = 0;
+    m_busy = true;
+    return p;
+  }
+
+  // The device asks after a transmission and may go idle, it is restarted on Wake
+  if (!m_interests.empty()) {
+    release(Simulator::Now(), !m_busy);
+  }
+
+  Ptr<Packet> p = m_queue->Dequeue();
+  if (p == 0) {
+    m_busy = false;
+    if (!m_interests.empty()) {
+      NS_LOG_LOGIC(m_interests.size() << " Interests held");
+      scheduleWake(getWait(Simulator::Now()));
+    }
+    return 0;
+  }
+
+  // The device is busy again until it asks for the next packet
+  m_busy = true;
+  Simulator::Cancel (m_wakeEvent);
+  if (m_waking) {
+    m_woken = p;
+  }
+  return p;
+}
+
+Ptr<const Packet>
+InterestShaperQueue::DoPeek (void) const
+{
+  NS_LOG_FUNCTION (this);
+
+  if (m_restart != 0) {
+    return m_restart;
+  }
+
+  // Dequeue releases the Interests due now before it picks a packet, the
+  // inner queue may pick a released one, so Peek has to release them too
+  if (!m_interests.empty()) {
+    const_cast<InterestShaperQueue*>(this)->release(Simulator::Now(), !m_busy);
+  }
+
+  return m_queue->Peek();
+}
+
+Time
+InterestShaperQueue::getWait (Time now) const
+{
+  // Reservations ending make room for PIs and raise the bucket rate
+  Time wait = m_nextExpiry == Time::Max() ? Time::Max() : m_nextExpiry - now;
+
+  double rate = std::max(getCapacity() - m_reservedRate, 0.0);
+  if (m_interests.front().pushRate == 0 && rate > 0) {
+    double missing = std::min(m_dataSize, m_burst) - m_tokens;
+    wait = std::min(wait, Seconds(std::max(missing, 0.0) / rate));
+  }
+  return wait;
+}
+
+void
+InterestShaperQueue::scheduleWake (Time wait)
+{
+  if (wait == Time::Max()) {
+    return;
+  }
+
+  // Round up, so the Interest is eligible when the event fires
+  wait += NanoSeconds(1);
+  if (m_wakeEvent.IsRunning() && Simulator::GetDelayLeft(m_wakeEvent) <= wait) {
+    return;
+  }
+  NS_LOG_LOGIC("Head Interest is eligible in " << wait);
+  Simulator::Cancel (m_wakeEvent);
+  m_wakeEvent = Simulator::Schedule(wait, &InterestShaperQueue::wake, this);
+}
+
+void
+InterestShaperQueue::wake (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  if (m_busy || m_interests.empty()) {
+    return;
+  }
+
+  Time now = Simulator::Now();
+  release(now, false);
+  if (m_queue->GetNPackets() == 0) {
+    scheduleWake(getWait(now));
+    return;
+  }
+
+  NS_LOG_LOGIC("Interest released after the device went idle");
+  fireWake(m_queue->Peek());
+}
+
+void
+InterestShaperQueue::innerWake (Ptr<const Packet> packet)
+{
+  NS_LOG_FUNCTION (this << packet);
+
+  if (!m_busy) {
+    fireWake(packet);
+  }
+}
+
+void
+InterestShaperQueue::fireWake (Ptr<const Packet> packet)
+{
+  m_waking = true;
+  m_wakeTrace(packet);
+  m_waking = false;
+}
+
+} // namespace ns3
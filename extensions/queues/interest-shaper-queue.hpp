@@ -0,0 +1,232 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2007 University of Washington
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef INTERESTSHAPERQUEUE_H
+#define INTERESTSHAPERQUEUE_H
+
+#include <deque>
+#include <unordered_map>
+#include "ns3/packet.h"
+#include "ns3/queue.h"
+#include "ns3/nstime.h"
+#include "ns3/data-rate.h"
+#include "ns3/event-id.h"
+#include "ns3/traced-callback.h"
+
+#include "flow-classifier.hpp"
+#include "sojourn-stats.hpp"
+
+namespace ns3 {
+
+/**
+ * \ingroup queue
+ *
+ * \brief A queue which shapes outgoing Interests by the Data they will bring back
+ *
+ * Every Interest sent on a face asks for a Data packet on the reverse link.
+ * The shaper releases Interests only as fast as the reverse link can carry
+ * their Data, so the Data queue of the upstream node does not overflow in the
+ * first place.
+ *
+ * Interests wait in a FIFO in front of the inner queue (see the Queue
+ * attribute), all other packets are handed to the inner queue directly. A
+ * token bucket filled at ReverseRate holds the bytes the reverse link can
+ * still carry, every released Interest takes the expected size of its Data
+ * (DataSize) from the bucket.
+ *
+ * A persistent Interest (PI) asks for a stream of Data instead. Its expected
+ * rate is the Frequency x PayloadSize of the push producer serving the name,
+ * which the producer registers with SetPushRate. The first PI of a stream
+ * reserves this rate on the reverse link and is held while the reservations
+ * would exceed ReverseRate. Refreshing PIs of a reserved stream pass
+ * immediately and extend the reservation by PushHoldTime. The bucket is only
+ * filled with the rate left by the reservations. PIs of unregistered names
+ * are shaped like regular Interests.
+ *
+ * Held Interests are released when the device asks for its next packet.
+ * If none is eligible and the inner queue is empty after a transmission,
+ * the device goes idle and the Wake trace source fires once the head
+ * Interest is eligible, or the inner queue fired its own Wake.
+ * QueueWakeHelper connects Wake to the device. A device which is idle
+ * needs a packet whenever a new one arrives though, so if the inner queue
+ * is empty then, the head Interest is released anyway and its Data is
+ * taken from the bucket as debt of at most Burst bytes (a PI reserves its
+ * rate beyond ReverseRate). A face which sends little but Interests is
+ * therefore not fully shaped: Interests are held back while the device is
+ * busy, but one arriving at the idle device passes at once.
+ */
+class InterestShaperQueue : public Queue {
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+  /**
+   * \brief InterestShaperQueue Constructor
+   *
+   * Creates a shaper in front of a FairQueue, shaping is disabled until
+   * ReverseRate is set
+   */
+  InterestShaperQueue ();
+
+  virtual ~InterestShaperQueue();
+
+  /**
+   * \brief Registers the rate of the Data pushed under a prefix
+   *
+   * The registration applies to all shapers, PIs are matched to the
+   * longest registered prefix of their name. Registrations are cleared
+   * when the simulation is destroyed.
+   *
+   * \param prefix Prefix of the pushed Data
+   * \param bytesPerSecond Frequency x PayloadSize of the producer
+   */
+  static void SetPushRate (const ::ndn::Name& prefix, double bytesPerSecond);
+
+  /**
+   * \return The number of Interests held by the shaper
+   */
+  uint32_t GetNHeldInterests (void) const;
+
+  /**
+   * \return The reverse link rate reserved by PIs in bytes per second
+   */
+  double GetReservedRate (void) const;
+
+  /**
+   * TracedCallback signature for a queue which has a packet to send again.
+   *
+   * \param [in] packet The packet to send next
+   */
+  typedef void (* WakeTracedCallback)(Ptr<const Packet> packet);
+
+protected:
+  virtual void NotifyConstructionCompleted (void);
+  virtual void DoDispose (void);
+  virtual bool DoEnqueue (Ptr<Packet> p);
+  virtual Ptr<Packet> DoDequeue (void);
+  virtual Ptr<const Packet> DoPeek (void) const;
+
+private:
+  /**
+   * \brief An Interest waiting for reverse link capacity
+   */
+  struct HeldInterest
+  {
+    Ptr<Packet> packet; //!< the Interest
+    uint64_t flowKey;   //!< stream of a PI, 0 for regular Interests
+    double pushRate;    //!< expected Data rate of a PI, 0 for regular Interests
+    uint32_t qci;       //!< QCI class of the Interest
+    Time enqueueTime;   //!< time the Interest was enqueued
+  };
+
+  /**
+   * \brief Adds the bytes the reverse link could carry since the last call to the bucket
+   */
+  void refill (Time now);
+
+  /**
+   * \brief Releases the reservations of streams whose PI was not refreshed in time
+   */
+  void expireReservations (Time now);
+
+  /**
+   * \brief Whether the reverse link has capacity for the Data of an Interest
+   */
+  bool isEligible (const HeldInterest& interest, Time now) const;
+
+  /**
+   * \brief Hands the eligible Interests at the head of the FIFO to the inner queue
+   *
+   * \param force Whether to release the head Interest regardless of the
+   * bucket if the inner queue stays empty, so Dequeue finds a packet
+   */
+  void release (Time now, bool force);
+
+  /**
+   * \brief Hands the Interest at the head of the FIFO to the inner queue
+   * and takes its Data from the bucket
+   */
+  void releaseFront (Time now);
+
+  /**
+   * \return The reverse link rate in bytes per second
+   */
+  double getCapacity (void) const;
+
+  /**
+   * \brief Returns the time until the head Interest is eligible
+   */
+  Time getWait (Time now) const;
+
+  /**
+   * \brief Schedules Wake for the time the head Interest is eligible
+   */
+  void scheduleWake (Time wait);
+
+  /**
+   * \brief Fires the Wake trace source if the device is idle and the head Interest is eligible
+   */
+  void wake (void);
+
+  /**
+   * \brief Fires the Wake trace source when the inner queue may send a held packet again
+   */
+  void innerWake (Ptr<const Packet> packet);
+
+  /**
+   * \brief Fires the Wake trace source, remembering the packet the device dequeues in turn
+   */
+  void fireWake (Ptr<const Packet> packet);
+
+  /**
+   * \brief A PI stream with reserved reverse link capacity
+   */
+  struct Reservation
+  {
+    double rate;  //!< reserved bytes per second
+    Time expires; //!< time at which the reservation ends unless the PI is refreshed
+  };
+
+  Ptr<Queue> m_queue;                 //!< queue of the released Interests and all other packets
+  std::deque<HeldInterest> m_interests; //!< Interests waiting for reverse link capacity
+  std::unordered_map<uint64_t, Reservation> m_reservations; //!< PI streams by flow key
+  ndn::FlowClassifier m_classifier;   //!< separates PI streams by the registered prefixes
+  Ptr<SojournStats> m_sojournStats;   //!< times the released Interests were held
+  uint32_t m_rulesVersion;            //!< version of the push rates the classifier was built from
+  DataRate m_reverseRate;             //!< rate of the reverse link, 0 disables shaping
+  uint32_t m_dataSize;                //!< expected Data size of a regular Interest
+  uint32_t m_burst;                   //!< size of the token bucket in bytes
+  uint32_t m_maxInterests;            //!< max Interests held by the shaper
+  Time m_pushHoldTime;                //!< lifetime of a PI reservation
+  double m_tokens;                    //!< bytes of Data the reverse link can still carry
+  Time m_lastRefill;                  //!< time of the last refill
+  double m_reservedRate;              //!< sum of the reserved rates
+  Time m_nextExpiry;                  //!< earliest end of a reservation
+  bool m_busy;                        //!< whether the device sends the packet of the last Dequeue
+  EventId m_wakeEvent;                //!< pending Wake, if the device went idle while Interests were held
+  TracedCallback<Ptr<const Packet> > m_wakeTrace; //!< fired when a packet may be sent after the device went idle
+  bool m_waking;                      //!< whether Wake is being fired
+  Ptr<Packet> m_woken;                //!< packet dequeued by Wake, which the device enqueues again
+  Ptr<Packet> m_restart;              //!< woken packet enqueued by the device, served first
+};
+
+} // namespace ns3
+
+#endif /* INTERESTSHAPERQUEUE_H */
@@ -19,16 +19,10 @@
 #include "ns3/log.h"
 #include "ns3/enum.h"
 #include "ns3/uinteger.h"
-#include "ns3/ppp-header.h"
-#include "ns3/ndnSIM/model/ndn-ns3.hpp"
+#include "ns3/string.h"
+#include "ns3/pointer.h"
 #include "ns3/simulator.h"
 
-#include "utils/ndn-ns3-packet-tag.hpp"
-#include "ns3/ndnSIM/ndn-cxx/encoding/qci.hpp"
-
-#include <ndn-cxx/encoding/block.hpp>
-#include <ndn-cxx/interest.hpp>
-#include <ndn-cxx/data.hpp>
 #include "priority-queue.hpp"
 
 namespace ns3 {
@@ -60,6 +54,42 @@ TypeId PriorityQueue::GetTypeId (void)
                    UintegerValue (100 * 1024),
                    MakeUintegerAccessor (&PriorityQueue::m_maxBytes),
                    MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("DropPolicy",
+                   "Whether a full queue drops the arriving packet or pushes out a queued packet of a lower priority class.",
+                   EnumValue (QUEUE_MODE_TAIL_DROP),
+                   MakeEnumAccessor (&PriorityQueue::SetDropPolicy,
+                                     &PriorityQueue::GetDropPolicy),
+                   MakeEnumChecker (QUEUE_MODE_TAIL_DROP, "QUEUE_MODE_TAIL_DROP",
+                                    QUEUE_MODE_LOWEST_PRIORITY_DROP, "QUEUE_MODE_LOWEST_PRIORITY_DROP"))
+    .AddAttribute ("Classifier",
+                   "Rules for separating traffic flows by name prefix, e.g. \"/=2 /video=4\" (see ndn::FlowClassifier::setRules).",
+                   StringValue (""),
+                   MakeStringAccessor (&PriorityQueue::SetClassifier,
+                                       &PriorityQueue::GetClassifier),
+                   MakeStringChecker ())
+    .AddAttribute ("FreshestQcis",
+                   "Real-time QCI classes whose flows drop their oldest packet instead of an arriving one on overflow, e.g. \"1 3\".",
+                   StringValue (""),
+                   MakeStringAccessor (&PriorityQueue::SetFreshestQcis,
+                                       &PriorityQueue::GetFreshestQcis),
+                   MakeStringChecker ())
+    .AddAttribute ("FreshestMaxPackets",
+                   "The maximum number of packets queued per flow of a FreshestQcis class, 0 for no limit.",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&PriorityQueue::m_freshestMaxPackets),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("SojournStats",
+                   "The sojourn time histograms of the packets leaving this queue, per QCI class and traffic flow.",
+                   TypeId::ATTR_GET,
+                   PointerValue (),
+                   MakePointerAccessor (&PriorityQueue::m_sojournStats),
+                   MakePointerChecker<SojournStats> ())
+    .AddAttribute ("BufferPartition",
+                   "The per-QCI buffer shares of this queue and the trace of its drops per class.",
+                   TypeId::ATTR_GET,
+                   PointerValue (),
+                   MakePointerAccessor (&PriorityQueue::m_bufferPartition),
+                   MakePointerChecker<BufferPartition> ())
   ;
 
   return tid;
@@ -68,9 +98,13 @@ TypeId PriorityQueue::GetTypeId (void)
 PriorityQueue::PriorityQueue () :
   Queue (),
   m_packets (),
-  m_bytesInQueue (0)
+  m_bytesInQueue (0),
+  m_dropPolicy (QUEUE_MODE_TAIL_DROP),
+  m_freshestMaxPackets (0)
 {
   NS_LOG_FUNCTION (this); 
+  m_sojournStats = CreateObject<SojournStats> ();
+  m_bufferPartition = CreateObject<BufferPartition> ();
 }
 
 PriorityQueue::~PriorityQueue ()
@@ -92,88 +126,117 @@ PriorityQueue::GetMode (void) const
   return m_mode;
 }
 
+void
+PriorityQueue::SetClassifier (std::string rules)
+{
+  NS_LOG_FUNCTION (this << rules);
+  m_classifier.setRules(rules);
+}
+
+std::string
+PriorityQueue::GetClassifier (void) const
+{
+  return m_classifier.getRules();
+}
+
 void
 PriorityQueue::SetDropPolicy (PriorityQueue::DropPolicy policy)
 {
+  NS_LOG_FUNCTION (this << policy);
   m_dropPolicy = policy;
 }
 
 PriorityQueue::DropPolicy
 PriorityQueue::GetDropPolicy () const
 {
+  NS_LOG_FUNCTION (this);
   return m_dropPolicy;
 }
 
+void
+PriorityQueue::SetFreshestQcis (std::string qcis)
+{
+  NS_LOG_FUNCTION (this << qcis);
+  m_freshestQcis.parse(qcis);
+}
+
+std::string
+PriorityQueue::GetFreshestQcis (void) const
+{
+  return m_freshestQcis.str();
+}
+
 bool 
 PriorityQueue::DoEnqueue (Ptr<Packet> p)
 {
   NS_LOG_FUNCTION (this << p);
 
-  Ptr<Packet> packet = p->Copy();
-
-  PppHeader ppp;
-  packet->RemoveHeader(ppp);
-
-  // Convert the packet to Interest or Data and get QCI class
-  std::string name = ""; 
-  uint32_t prio = ndn::QCI_CLASSES::QCI_9; // Default QCI class is 9
-  try {
-    switch (ndn::Convert::getPacketType(packet)) {
-      case ::ndn::tlv::Interest: {
-        std::shared_ptr<const ::ndn::Interest> i = ndn::Convert::FromPacket<::ndn::Interest>(packet);
-        ::ndn::Name prefix = i->getName();
-        prefix = prefix.getPrefix(2);
-        name = prefix.toUri();
-        if (i->getQCI() != 0) {
-          prio = i->getQCI();
-        }
-        break;
-      }
-      case ::ndn::tlv::Data: {
-        std::shared_ptr<const ::ndn::Data> d = ndn::Convert::FromPacket<::ndn::Data>(packet);
-        ::ndn::Name prefix = d->getName();
-        prefix = prefix.getPrefix(2);
-        name = prefix.toUri();
-        if (d->getQCI() != 0) {
-          prio = d->getQCI();
-        }
-        break;
-      }
-      // case ::ndn::tlv::Nack: {
-      //   shared_ptr<const Nack> n = Convert::FromPacket<Nack>(packet);
-      //   this->onReceiveNack(*n);
-      // }
-      default:
-        NS_LOG_ERROR("Unsupported TLV packet");
-    }
-  }
-  catch (const ::ndn::tlv::Error& e) {
-    NS_LOG_ERROR("Unrecognized TLV packet " << e.what());
-  }
+  // Get the QCI class of the packet, default QCI class is 9
+  ndn::FlowInfo info = m_classifier.classify(p);
+  uint32_t prio = info.qci;
 
-  NS_LOG_DEBUG("Queuing packet with name: " << name);
+  NS_LOG_DEBUG("Queuing packet of flow " << info.flowKey);
 
   //NS_LOG_FUNCTION()
 
-  if (m_mode == QUEUE_MODE_PACKETS && (m_packets.size() >= m_maxPackets))
+  // Real-time classes make room by dropping the oldest packets of their own flow
+  uint32_t stale = 0;
+  uint32_t staleBytes = 0;
+  if (m_freshestQcis.contains(prio)) {
+    stale = countStale(prio, info.flowKey, p->GetSize (), staleBytes);
+  }
+
+  // Classes beyond their buffer share are dropped before they crowd out others.
+  // The share counts the stale packets as gone, and lower priority classes
+  // which borrowed from the shared pool are pushed out to free it.
+  m_bufferPartition->SetLimit(m_mode == QUEUE_MODE_PACKETS ? m_maxPackets : m_maxBytes, m_mode == QUEUE_MODE_BYTES);
+  while (!m_bufferPartition->Admit(prio, p->GetSize (), stale, staleBytes))
     {
-      NS_LOG_LOGIC ("Queue full (at max packets) -- droppping pkt");
+      if (canPushOut(prio) && m_bufferPartition->IsBorrowing(m_packets.lastPriority())
+          && m_bufferPartition->FitsMaximum(prio, p->GetSize (), stale, staleBytes))
+        {
+          NS_LOG_LOGIC ("Shared buffer pool exhausted -- pushing out pkt of priority " << m_packets.lastPriority());
+          pushOut();
+          continue;
+        }
+
+      NS_LOG_LOGIC ("Buffer share of QCI " << prio << " exhausted -- droppping pkt");
+      m_bufferPartition->NotifyDrop (p, prio);
       Drop (p);
       return false;
     }
 
-  if (m_mode == QUEUE_MODE_BYTES && (m_bytesInQueue + p->GetSize () >= m_maxBytes))
+  if (stale > 0) {
+    NS_LOG_LOGIC ("Fresher pkt arrived -- dropping " << stale << " oldest pkts of flow " << info.flowKey);
+    dropStale(prio, info.flowKey, stale);
+  }
+
+  while (isFull (p->GetSize ()))
     {
-      NS_LOG_LOGIC ("Queue full (packet would exceed max bytes) -- droppping pkt");
+      if (canPushOut(prio))
+        {
+          NS_LOG_LOGIC ("Queue full -- pushing out pkt of priority " << m_packets.lastPriority());
+          pushOut();
+          continue;
+        }
+
+      NS_LOG_LOGIC ("Queue full -- droppping pkt");
+      m_bufferPartition->NotifyDrop (p, prio);
       Drop (p);
       return false;
     }
 
   m_bytesInQueue += p->GetSize ();
+  m_bufferPartition->Add(prio, p->GetSize ());
 
   // Add packet to queue
   NS_LOG_DEBUG("Priority of packet " << prio);
-  m_packets.push(p, prio);
+  Entry entry;
+  entry.packet = p;
+  entry.qci = prio;
+  entry.flowKey = info.flowKey;
+  entry.enqueueTime = Simulator::Now();
+  m_packets.push(entry, prio);
 
 
   NS_LOG_LOGIC ("Number packets " << m_packets.size());
@@ -182,6 +245,88 @@ PriorityQueue::DoEnqueue (Ptr<Packet> p)
   return true;
 }
 
+bool
+PriorityQueue::isFull (uint32_t size) const
+{
+  return isFull (m_packets.size(), m_bytesInQueue, size);
+}
+
+bool
+PriorityQueue::isFull (uint32_t packets, uint32_t bytes, uint32_t size) const
+{
+  if (m_mode == QUEUE_MODE_PACKETS)
+    {
+      return packets >= m_maxPackets;
+    }
+  return bytes + size >= m_maxBytes;
+}
+
+bool
+PriorityQueue::canPushOut (uint32_t qci) const
+{
+  return m_dropPolicy == QUEUE_MODE_LOWEST_PRIORITY_DROP && m_packets.size() > 0
+         && m_packets.lastPriority() > qci;
+}
+
+void
+PriorityQueue::pushOut (void)
+{
+  Entry victim = m_packets.popBack();
+  m_bytesInQueue -= victim.packet->GetSize ();
+  m_bufferPartition->Remove(victim.qci, victim.packet->GetSize ());
+  m_bufferPartition->NotifyDrop (victim.packet, victim.qci);
+  DropQueued (victim.packet);
+}
+
+uint32_t
+PriorityQueue::countStale (uint32_t qci, uint64_t flowKey, uint32_t size, uint32_t& staleBytes) const
+{
+  uint32_t queued = m_packets.size(qci);
+  uint32_t flowPackets = 0;
+  if (m_freshestMaxPackets > 0) {
+    for (uint32_t i = 0; i < queued; i++) {
+      if (m_packets.at(qci, i).flowKey == flowKey) {
+        flowPackets++;
+      }
+    }
+  }
+
+  uint32_t packets = m_packets.size();
+  uint32_t bytes = m_bytesInQueue;
+  uint32_t stale = 0;
+  for (uint32_t i = 0; i < queued &&
+       (isFull(packets, bytes, size) ||
+        (m_freshestMaxPackets > 0 && flowPackets - stale >= m_freshestMaxPackets)); i++) {
+    const Entry& entry = m_packets.at(qci, i);
+    if (entry.flowKey == flowKey) {
+      packets--;
+      bytes -= entry.packet->GetSize ();
+      stale++;
+    }
+  }
+  if (isFull(packets, bytes, size)) {
+    return 0;
+  }
+  staleBytes = m_bytesInQueue - bytes;
+  return stale;
+}
+
+void
+PriorityQueue::dropStale (uint32_t qci, uint64_t flowKey, uint32_t count)
+{
+  std::vector<Entry> victims;
+  victims.reserve(count);
+  m_packets.eraseOldest(qci, count, [flowKey] (const Entry& entry) { return entry.flowKey == flowKey; },
+                        victims);
+
+  for (const Entry& entry : victims) {
+    m_bytesInQueue -= entry.packet->GetSize ();
+    m_bufferPartition->Remove(qci, entry.packet->GetSize ());
+    m_bufferPartition->NotifyDrop (entry.packet, qci);
+    DropQueued (entry.packet);
+  }
+}
+
 Ptr<Packet>
 PriorityQueue::DoDequeue (void)
 {
@@ -193,9 +338,12 @@ PriorityQueue::DoDequeue (void)
     return 0;
   }
 
-  auto p = m_packets.pop();
+  Entry entry = m_packets.pop();
+  m_sojournStats->Record(entry.qci, entry.flowKey, Simulator::Now() - entry.enqueueTime);
+  Ptr<Packet> p = entry.packet;
 
   m_bytesInQueue -= p->GetSize ();
+  m_bufferPartition->Remove(entry.qci, p->GetSize ());
 
   NS_LOG_LOGIC ("Popped " << p);
 
@@ -216,7 +364,7 @@ PriorityQueue::DoPeek (void) const
     return 0;
   }
 
-  auto p = m_packets.top();
+  Ptr<Packet> p = m_packets.top().packet;
 
   NS_LOG_LOGIC ("Popped " << p);
 
@@ -20,10 +20,16 @@
 #define PRIORITYQUEUE_H
 
 #include <queue>
+#include <string>
 #include "ns3/packet.h"
 #include "ns3/queue.h"
+#include "ns3/nstime.h"
 
+#include "buffer-partition.hpp"
 #include "generic-priority-queue.hpp"
+#include "flow-classifier.hpp"
+#include "qci-set.hpp"
+#include "sojourn-stats.hpp"
 
 namespace ns3 {
 
@@ -38,7 +44,7 @@ struct PriorityComparator
 /**
  * \ingroup queue
  *
- * \brief A Priority packet queue with tail-drop drop policy.
+ * \brief A Priority packet queue with tail-drop or push-out drop policy.
  *
  * Priority queuing takes into account that some packets are more important
  * than others. Therefore priority queuing first handles the more important
@@ -46,6 +52,22 @@ struct PriorityComparator
  * 
  * Packets without priority flag are handled with QCI class 9, which is 
  * the default class in the QCI model.
+ *
+ * With the QUEUE_MODE_LOWEST_PRIORITY_DROP policy a full queue makes room for
+ * an arriving packet by dropping the most recently queued packets of the
+ * lowest priority class, if that class is of lower priority than the arriving
+ * packet. Otherwise the arriving packet is dropped.
+ *
+ * For real-time classes listed in FreshestQcis an arriving packet drops the
+ * oldest queued packets of its own flow (head drop) instead when the queue is
+ * full, and FreshestMaxPackets additionally caps each of these flows. The
+ * flows of a class share its FIFO, so finding the packets of a flow is linear
+ * in the packets queued in the class.
+ *
+ * The BufferPartition object splits MaxPackets or MaxBytes into per-QCI
+ * shares, a packet beyond the share of its class is dropped on arrival and
+ * does not push out other packets. The Drop trace of the partition reports
+ * every drop of the queue with the class of the packet.
  */
 class PriorityQueue : public Queue {
 public:
@@ -78,23 +100,96 @@ public:
    */
   PriorityQueue::QueueMode GetMode (void) const;
 
+  /**
+   * \brief Sets the rules which separate traffic flows by name prefix
+   *
+   * \param rules Rules as accepted by ndn::FlowClassifier::setRules
+   */
+  void SetClassifier (std::string rules);
+
+  std::string GetClassifier (void) const;
+
   void
   SetDropPolicy (PriorityQueue::DropPolicy policy);
 
   PriorityQueue::DropPolicy
   GetDropPolicy (void) const;
 
+  /**
+   * \brief Sets the real-time QCI classes whose flows keep their freshest packets
+   *
+   * \param qcis List of QCI values as accepted by QciSet::parse
+   */
+  void SetFreshestQcis (std::string qcis);
+
+  std::string GetFreshestQcis (void) const;
+
 protected:
   virtual bool DoEnqueue (Ptr<Packet> p);
   virtual Ptr<Packet> DoDequeue (void);
   virtual Ptr<const Packet> DoPeek (void) const;
 
-  ::PriorityQueue<Ptr<Packet>> m_packets; //!< the packets in the queue
+  /**
+   * \brief Whether a packet of the given size exceeds the queue limit
+   */
+  bool isFull (uint32_t size) const;
+
+  /**
+   * \brief Whether a packet of the given size exceeds the limit of a queue with the given content
+   */
+  bool isFull (uint32_t packets, uint32_t bytes, uint32_t size) const;
+
+  /**
+   * \brief Returns the number of packets of a flow to drop for an arriving packet of a FreshestQcis class
+   *
+   * The oldest packets of the flow are dropped while the queue is full or
+   * the flow holds FreshestMaxPackets. If dropping all of them does not make
+   * room, none is dropped and 0 is returned.
+   *
+   * \param[out] staleBytes Bytes of the packets to drop
+   */
+  uint32_t countStale (uint32_t qci, uint64_t flowKey, uint32_t size, uint32_t& staleBytes) const;
+
+  /**
+   * \brief Whether a packet of the given class may push out queued packets
+   *
+   * With QUEUE_MODE_LOWEST_PRIORITY_DROP, packets of a lower priority class
+   * make room for it.
+   */
+  bool canPushOut (uint32_t qci) const;
+
+  /**
+   * \brief Removes and drops the newest packet of the lowest priority class
+   */
+  void pushOut (void);
+
+  /**
+   * \brief Removes and drops the given number of the oldest packets of a flow in the given class
+   */
+  void dropStale (uint32_t qci, uint64_t flowKey, uint32_t count);
+
+  /**
+   * \brief A queued packet with the data needed to account its sojourn time
+   */
+  struct Entry
+  {
+    Ptr<Packet> packet;   //!< the queued packet
+    uint32_t qci;         //!< QCI class of the packet
+    uint64_t flowKey;     //!< flow key as computed by ndn::FlowClassifier
+    Time enqueueTime;     //!< time the packet was enqueued
+  };
+
+  ::PriorityQueue<Entry, ndn::FlowClassifier::QCI_BUCKETS> m_packets; //!< the packets in the queue
+  ndn::FlowClassifier m_classifier;   //!< extracts the QCI class of packets
+  Ptr<SojournStats> m_sojournStats;   //!< sojourn times of the dequeued packets
+  Ptr<BufferPartition> m_bufferPartition; //!< per-QCI buffer shares and class drop trace
   uint32_t m_maxPackets;              //!< max packets in the queue
   uint32_t m_maxBytes;                //!< max bytes in the queue
   uint32_t m_bytesInQueue;            //!< actual bytes in the queue
   QueueMode m_mode;                   //!< queue mode (packets or bytes limited)
   PriorityQueue::DropPolicy m_dropPolicy;
+  QciSet m_freshestQcis;              //!< real-time classes whose flows drop their oldest packets first
+  uint32_t m_freshestMaxPackets;      //!< max packets of a flow of a FreshestQcis class, 0 for no cap
 };
 
 } // namespace ns3
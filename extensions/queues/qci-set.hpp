@@ -0,0 +1,110 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef QCISET_H
+#define QCISET_H
+
+#include <inttypes.h>
+#include <algorithm>
+#include <bitset>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include "flow-classifier.hpp"
+
+namespace ns3 {
+
+/**
+ * \brief A set of QCI classes, configured as a list such as "1 3 65"
+ *
+ * QCI values of QCI_BUCKETS or more stand for the last bucket, like in
+ * ndn::FlowClassifier, so contains () takes the QCI of a FlowInfo as is.
+ */
+class QciSet
+{
+public:
+  static const uint32_t CLASSES = ndn::FlowClassifier::QCI_BUCKETS;
+
+  /**
+   * \brief Replaces the set by the QCI values of a list
+   *
+   * The values are separated by whitespace, `,` or `;`, an empty list clears the set.
+   *
+   * \throw std::invalid_argument if an entry is not a QCI value
+   */
+  void
+  parse (const std::string& list)
+  {
+    std::bitset<CLASSES> classes;
+
+    std::string entries = list;
+    std::replace (entries.begin (), entries.end (), ',', ' ');
+    std::replace (entries.begin (), entries.end (), ';', ' ');
+    std::istringstream is (entries);
+    std::string entry;
+    while (is >> entry)
+      {
+        size_t parsed = 0;
+        unsigned long qci = 0;
+        try
+          {
+            qci = std::stoul (entry, &parsed);
+          }
+        catch (const std::logic_error&)
+          {
+            parsed = 0;
+          }
+        if (parsed != entry.size ())
+          {
+            throw std::invalid_argument ("QCI list entry `" + entry + "` is not a number");
+          }
+        classes.set (std::min<unsigned long> (qci, CLASSES - 1));
+      }
+
+    m_classes = classes;
+    m_list = list;
+  }
+
+  /**
+   * \brief Returns the list given to parse
+   */
+  const std::string&
+  str () const
+  {
+    return m_list;
+  }
+
+  bool
+  contains (uint32_t qci) const
+  {
+    return m_classes.test (std::min (qci, CLASSES - 1));
+  }
+
+  bool
+  empty () const
+  {
+    return m_classes.none ();
+  }
+
+private:
+  std::bitset<CLASSES> m_classes;  //!< bit of every contained class
+  std::string m_list;              //!< list as given to parse
+};
+
+} // namespace ns3
+
+#endif /* QCISET_H */
@@ -0,0 +1,103 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2007 University of Washington
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/log.h"
+#include "ns3/callback.h"
+#include "ns3/node.h"
+#include "ns3/node-list.h"
+#include "ns3/ppp-header.h"
+#include "ns3/queue.h"
+
+#include "queue-wake-helper.hpp"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("QueueWakeHelper");
+
+namespace {
+
+/**
+ * \brief Maps the PPP protocol number back to the EtherType PointToPointNetDevice::Send takes
+ */
+uint16_t
+pppToEther (uint16_t protocol)
+{
+  switch (protocol)
+    {
+    case 0x0021: return 0x0800; // IPv4
+    case 0x0057: return 0x86DD; // IPv6
+    case 0x0077: return 0x7777; // NDN, as mapped by the ndnSIM point-to-point device
+    default: NS_FATAL_ERROR ("PPP protocol number " << protocol << " not defined");
+    }
+  return 0;
+}
+
+} // namespace
+
+bool
+QueueWakeHelper::Install (Ptr<NetDevice> device)
+{
+  NS_LOG_FUNCTION (device);
+
+  Ptr<PointToPointNetDevice> p2pDevice = DynamicCast<PointToPointNetDevice> (device);
+  if (p2pDevice == 0 || p2pDevice->GetQueue () == 0)
+    {
+      return false;
+    }
+  return p2pDevice->GetQueue ()->TraceConnectWithoutContext ("Wake", MakeBoundCallback (&QueueWakeHelper::Restart, p2pDevice));
+}
+
+void
+QueueWakeHelper::Install (const NetDeviceContainer& devices)
+{
+  for (NetDeviceContainer::Iterator device = devices.Begin (); device != devices.End (); ++device)
+    {
+      Install (*device);
+    }
+}
+
+void
+QueueWakeHelper::InstallAll (void)
+{
+  for (NodeList::Iterator node = NodeList::Begin (); node != NodeList::End (); ++node)
+    {
+      for (uint32_t i = 0; i < (*node)->GetNDevices (); i++)
+        {
+          Install ((*node)->GetDevice (i));
+        }
+    }
+}
+
+void
+QueueWakeHelper::Restart (Ptr<PointToPointNetDevice> device, Ptr<const Packet> packet)
+{
+  NS_LOG_FUNCTION (device << packet);
+
+  Ptr<Packet> p = device->GetQueue ()->Dequeue ();
+  if (p == 0)
+    {
+      return;
+    }
+
+  // Send adds the header again
+  PppHeader ppp;
+  p->RemoveHeader (ppp);
+  device->Send (p, device->GetBroadcast (), pppToEther (ppp.GetProtocol ()));
+}
+
+} // namespace ns3
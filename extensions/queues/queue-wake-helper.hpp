@@ -0,0 +1,76 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2007 University of Washington
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef QUEUEWAKEHELPER_H
+#define QUEUEWAKEHELPER_H
+
+#include "ns3/packet.h"
+#include "ns3/net-device-container.h"
+#include "ns3/point-to-point-net-device.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup queue
+ *
+ * \brief Restarts point-to-point devices whose queue held packets back
+ *
+ * A PointToPointNetDevice goes idle when Dequeue returns no packet after a
+ * transmission, and only asks its queue again when a new packet arrives.
+ * Queues which hold packets back, like ShapingQueue, fire their Wake trace
+ * source when a held packet may be sent. The helper connects Wake to the
+ * device: it dequeues the packet, strips the PppHeader and passes it to
+ * PointToPointNetDevice::Send again, which starts the transmission. The
+ * queue recognizes the packet when the device enqueues it and serves it
+ * first. The enqueue, dequeue and MacTx trace sources of the device see
+ * the packet twice.
+ *
+ *     PointToPointHelper p2p;
+ *     p2p.SetQueue("ns3::ShapingQueue", "Rates", StringValue("90=300kbps:3000"));
+ *     QueueWakeHelper::Install(p2p.Install(nodes.Get(0), nodes.Get(1)));
+ */
+class QueueWakeHelper
+{
+public:
+  /**
+   * \brief Restarts the device whenever its queue fires Wake
+   *
+   * \return false if the device is no PointToPointNetDevice or its queue has no Wake trace source
+   */
+  static bool Install (Ptr<NetDevice> device);
+
+  /**
+   * \brief Restarts the devices of the container whose queue has a Wake trace source
+   */
+  static void Install (const NetDeviceContainer& devices);
+
+  /**
+   * \brief Restarts the devices of all nodes whose queue has a Wake trace source
+   */
+  static void InstallAll (void);
+
+private:
+  /**
+   * \brief Sends the packet which woke the queue of a device
+   */
+  static void Restart (Ptr<PointToPointNetDevice> device, Ptr<const Packet> packet);
+};
+
+} // namespace ns3
+
+#endif /* QUEUEWAKEHELPER_H */
@@ -0,0 +1,487 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2007 University of Washington
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/log.h"
+#include "ns3/enum.h"
+#include "ns3/uinteger.h"
+#include "ns3/string.h"
+#include "ns3/pointer.h"
+#include "ns3/data-rate.h"
+#include "ns3/simulator.h"
+#include "ns3/trace-source-accessor.h"
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+#include "shaping-queue.hpp"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("ShapingQueue");
+
+NS_OBJECT_ENSURE_REGISTERED (ShapingQueue);
+
+const uint32_t ShapingQueue::CLASSES;
+const uint32_t ShapingQueue::NONE;
+
+TypeId ShapingQueue::GetTypeId (void) 
+{
+  static TypeId tid = TypeId ("ns3::ShapingQueue")
+    .SetParent<Queue> ()
+    .SetGroupName("Network")
+    .AddConstructor<ShapingQueue> ()
+    .AddAttribute ("Mode", 
+                   "Whether to use bytes (see MaxBytes) or packets (see MaxPackets) as the maximum queue size metric.",
+                   EnumValue (QUEUE_MODE_PACKETS),
+                   MakeEnumAccessor (&ShapingQueue::SetMode,
+                                     &ShapingQueue::GetMode),
+                   MakeEnumChecker (QUEUE_MODE_BYTES, "QUEUE_MODE_BYTES",
+                                    QUEUE_MODE_PACKETS, "QUEUE_MODE_PACKETS"))
+    .AddAttribute ("MaxPackets", 
+                   "The maximum number of packets accepted by this ShapingQueue.",
+                   UintegerValue (100),
+                   MakeUintegerAccessor (&ShapingQueue::m_maxPackets),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("MaxBytes", 
+                   "The maximum number of bytes accepted by this ShapingQueue.",
+                   UintegerValue (100 * 1024),
+                   MakeUintegerAccessor (&ShapingQueue::m_maxBytes),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("Classifier",
+                   "Rules for separating traffic flows by name prefix, e.g. \"/=2 /video=4\" (see ndn::FlowClassifier::setRules).",
+                   StringValue (""),
+                   MakeStringAccessor (&ShapingQueue::SetClassifier,
+                                       &ShapingQueue::GetClassifier),
+                   MakeStringChecker ())
+    .AddAttribute ("Rates",
+                   "Token bucket rate and burst in bytes per QCI class, e.g. \"80=300kbps:3000 90=300kbps:3000\".",
+                   StringValue (""),
+                   MakeStringAccessor (&ShapingQueue::SetRates,
+                                       &ShapingQueue::GetRates),
+                   MakeStringChecker ())
+    .AddAttribute ("BorrowQcis",
+                   "QCI classes which may use the tokens other shaped classes leave unused.",
+                   StringValue ("80 90"),
+                   MakeStringAccessor (&ShapingQueue::SetBorrowQcis,
+                                       &ShapingQueue::GetBorrowQcis),
+                   MakeStringChecker ())
+    .AddAttribute ("SojournStats",
+                   "The sojourn time histograms of the packets leaving this queue, per QCI class and traffic flow.",
+                   TypeId::ATTR_GET,
+                   PointerValue (),
+                   MakePointerAccessor (&ShapingQueue::m_sojournStats),
+                   MakePointerChecker<SojournStats> ())
+    .AddTraceSource ("Wake",
+                     "A queued packet conforms again after the device found no packet to send.",
+                     MakeTraceSourceAccessor (&ShapingQueue::m_wakeTrace),
+                     "ns3::ShapingQueue::WakeTracedCallback")
+  ;
+
+  return tid;
+}
+
+ShapingQueue::ShapingQueue () :
+  Queue (),
+  m_packets (),
+  m_spare (0),
+  m_spareBurst (0),
+  m_busy (false),
+  m_waking (false),
+  m_bytesInQueue (0)
+{
+  NS_LOG_FUNCTION (this); 
+  m_sojournStats = CreateObject<SojournStats> ();
+}
+
+ShapingQueue::~ShapingQueue ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+ShapingQueue::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  Simulator::Cancel (m_wakeEvent);
+  m_woken = 0;
+  m_restart = 0;
+  Queue::DoDispose ();
+}
+
+void
+ShapingQueue::SetMode (ShapingQueue::QueueMode mode)
+{
+  NS_LOG_FUNCTION (this << mode);
+  m_mode = mode;
+}
+
+ShapingQueue::QueueMode
+ShapingQueue::GetMode (void) const
+{
+  NS_LOG_FUNCTION (this);
+  return m_mode;
+}
+
+void
+ShapingQueue::SetClassifier (std::string rules)
+{
+  NS_LOG_FUNCTION (this << rules);
+  m_classifier.setRules(rules);
+}
+
+std::string
+ShapingQueue::GetClassifier (void) const
+{
+  return m_classifier.getRules();
+}
+
+void
+ShapingQueue::SetRates (std::string rates)
+{
+  NS_LOG_FUNCTION (this << rates);
+
+  std::array<Bucket, CLASSES> buckets;
+  std::vector<uint32_t> shaped;
+  double spareBurst = 0;
+
+  std::string entries = rates;
+  std::replace (entries.begin (), entries.end (), ',', ' ');
+  std::replace (entries.begin (), entries.end (), ';', ' ');
+  std::istringstream is (entries);
+  std::string entry;
+  while (is >> entry) {
+    size_t equal = entry.find('=');
+    size_t colon = entry.find(':', equal);
+    unsigned long qci = 0;
+    DataRate rate;
+    unsigned long burst = 1500;
+    bool valid = equal != std::string::npos;
+    try {
+      size_t parsed = 0;
+      if (valid) {
+        std::string value = entry.substr(0, equal);
+        qci = std::stoul(value, &parsed);
+        valid = parsed == value.size();
+      }
+      if (valid) {
+        std::istringstream value (entry.substr(equal + 1, colon == std::string::npos ? std::string::npos : colon - equal - 1));
+        value >> rate;
+        valid = !value.fail() && rate.GetBitRate() > 0;
+      }
+      if (valid && colon != std::string::npos) {
+        std::string value = entry.substr(colon + 1);
+        burst = std::stoul(value, &parsed);
+        valid = parsed == value.size() && burst > 0;
+      }
+    } catch (const std::logic_error&) {
+      valid = false;
+    }
+    if (!valid) {
+      throw std::invalid_argument("Token bucket `" + entry + "` is not of the form qci=rate:burst");
+    }
+
+    uint32_t index = std::min<unsigned long>(qci, CLASSES - 1);
+    if (buckets[index].rate == 0) {
+      shaped.push_back(index);
+    }
+    buckets[index].rate = rate.GetBitRate() / 8.0;
+    buckets[index].burst = burst;
+    buckets[index].tokens = burst;
+    spareBurst = std::max<double>(spareBurst, burst);
+  }
+
+  m_buckets = buckets;
+  m_shaped = shaped;
+  m_spare = 0;
+  m_spareBurst = spareBurst;
+  m_lastRefill = Simulator::Now();
+  m_rates = rates;
+}
+
+std::string
+ShapingQueue::GetRates (void) const
+{
+  return m_rates;
+}
+
+void
+ShapingQueue::SetBorrowQcis (std::string qcis)
+{
+  NS_LOG_FUNCTION (this << qcis);
+  m_borrowQcis.parse(qcis);
+}
+
+std::string
+ShapingQueue::GetBorrowQcis (void) const
+{
+  return m_borrowQcis.str();
+}
+
+double
+ShapingQueue::GetTokens (uint32_t qci) const
+{
+  return m_buckets[std::min(qci, CLASSES - 1)].tokens;
+}
+
+double
+ShapingQueue::GetSpareTokens (void) const
+{
+  return m_spare;
+}
+
+bool 
+ShapingQueue::DoEnqueue (Ptr<Packet> p)
+{
+  NS_LOG_FUNCTION (this << p);
+
+  if (p == m_woken) {
+    // The device sends the packet Wake handed out, it keeps its place at the head
+    m_woken = 0;
+    m_restart = p;
+    m_bytesInQueue += p->GetSize ();
+    return true;
+  }
+
+  ndn::FlowInfo info = m_classifier.classify(p);
+
+  if (isFull (p->GetSize ()))
+    {
+      NS_LOG_LOGIC ("Queue full -- droppping pkt");
+      Drop (p);
+      return false;
+    }
+
+  m_bytesInQueue += p->GetSize ();
+  Entry entry;
+  entry.packet = p;
+  entry.flowKey = info.flowKey;
+  entry.enqueueTime = Simulator::Now();
+  m_packets.push(entry, info.qci);
+
+  NS_LOG_LOGIC ("Number packets " << m_packets.size());
+  NS_LOG_LOGIC ("Number bytes " << m_bytesInQueue);
+
+  return true;
+}
+
+Ptr<Packet>
+ShapingQueue::DoDequeue (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  m_woken = 0;
+  if (m_restart != 0)
+  {
+    Ptr<Packet> p = m_restart;
+    m_restart = 0;
+    m_bytesInQueue -= p->GetSize ();
+    m_busy = true;
+    NS_LOG_LOGIC ("Popped woken " << p);
+    return p;
+  }
+
+  if (m_packets.size() == 0)
+  {
+    NS_LOG_LOGIC ("Queue empty");
+    m_busy = false;
+    return 0;
+  }
+
+  refill(Simulator::Now());
+  uint32_t qci = selectClass();
+  Time wait = getWait(qci);
+  if (m_busy && !wait.IsZero()) {
+    // The device asks after a transmission and may go idle, it is restarted on Wake
+    NS_LOG_LOGIC ("No packet conforms, " << m_packets.size() << " packets held");
+    m_busy = false;
+    scheduleWake(wait);
+    return 0;
+  }
+
+  // The device is busy again until it asks for the next packet
+  m_busy = true;
+  Simulator::Cancel (m_wakeEvent);
+
+  Entry entry = m_packets.pop(qci);
+  m_sojournStats->Record(qci, entry.flowKey, Simulator::Now() - entry.enqueueTime);
+  Ptr<Packet> p = entry.packet;
+  Bucket& bucket = m_buckets[qci];
+  if (bucket.rate > 0) {
+    double size = p->GetSize ();
+    if (bucket.tokens < getNeeded(qci, p->GetSize ()) && m_borrowQcis.contains(qci)) {
+      // Take what the own bucket lacks from the spare bucket
+      double borrowed = std::min(m_spare, size - std::max(bucket.tokens, 0.0));
+      m_spare -= borrowed;
+      size -= borrowed;
+    }
+    // A packet sent to an idle device before it conforms leaves the class in
+    // debt, which is bounded so the class is not starved afterwards
+    bucket.tokens = std::max(bucket.tokens - size, -bucket.burst);
+  }
+
+  m_bytesInQueue -= p->GetSize ();
+  if (m_waking) {
+    m_woken = p;
+  }
+
+  NS_LOG_LOGIC ("Popped " << p << " of QCI " << qci);
+
+  NS_LOG_LOGIC ("Number packets " << m_packets.size());
+  NS_LOG_LOGIC ("Number bytes " << m_bytesInQueue);
+
+  return p;
+}
+
+Ptr<const Packet>
+ShapingQueue::DoPeek (void) const
+{
+  NS_LOG_FUNCTION (this);
+
+  if (m_restart != 0)
+  {
+    return m_restart;
+  }
+
+  if (m_packets.size() == 0)
+  {
+    NS_LOG_LOGIC ("Queue empty");
+    return 0;
+  }
+
+  refill(Simulator::Now());
+  uint32_t qci = selectClass();
+  if (m_busy && !getWait(qci).IsZero()) {
+    NS_LOG_LOGIC ("No packet conforms");
+    return 0;
+  }
+  return m_packets.at(qci, 0).packet;
+}
+
+void
+ShapingQueue::refill (Time now) const
+{
+  if (now <= m_lastRefill) {
+    return;
+  }
+
+  double seconds = (now - m_lastRefill).GetSeconds();
+  m_lastRefill = now;
+  for (uint32_t qci : m_shaped) {
+    Bucket& bucket = m_buckets[qci];
+    bucket.tokens += bucket.rate * seconds;
+    if (bucket.tokens > bucket.burst) {
+      m_spare += bucket.tokens - bucket.burst;
+      bucket.tokens = bucket.burst;
+    }
+  }
+  m_spare = std::min(m_spare, m_spareBurst);
+}
+
+uint32_t
+ShapingQueue::selectClass (void) const
+{
+  uint32_t first = NONE;
+  Time firstWait = Time::Max();
+  for (uint32_t qci = m_packets.nextPriority(0); qci != NONE; qci = m_packets.nextPriority(qci + 1)) {
+    Time wait = getWait(qci);
+    if (wait.IsZero()) {
+      return qci;
+    }
+    if (wait < firstWait) {
+      first = qci;
+      firstWait = wait;
+    }
+  }
+
+  NS_LOG_LOGIC ("No packet conforms, QCI " << first << " conforms first in " << firstWait);
+  return first;
+}
+
+Time
+ShapingQueue::getWait (uint32_t qci) const
+{
+  const Bucket& bucket = m_buckets[qci];
+  if (bucket.rate == 0) {
+    return Time();
+  }
+
+  double missing = getNeeded(qci, m_packets.at(qci, 0).packet->GetSize ()) - bucket.tokens;
+  if (m_borrowQcis.contains(qci)) {
+    missing -= m_spare;
+  }
+  if (missing <= 0) {
+    return Time();
+  }
+  return Seconds(missing / bucket.rate);
+}
+
+double
+ShapingQueue::getNeeded (uint32_t qci, uint32_t size) const
+{
+  // Packets larger than the burst would never fit, they wait for a full bucket
+  return std::min<double>(size, m_buckets[qci].burst);
+}
+
+void
+ShapingQueue::scheduleWake (Time wait)
+{
+  // Round up, so the packet conforms when the event fires
+  wait += NanoSeconds(1);
+  if (m_wakeEvent.IsRunning() && Simulator::GetDelayLeft(m_wakeEvent) <= wait) {
+    return;
+  }
+  NS_LOG_LOGIC ("Next packet conforms in " << wait);
+  Simulator::Cancel (m_wakeEvent);
+  m_wakeEvent = Simulator::Schedule(wait, &ShapingQueue::wake, this);
+}
+
+void
+ShapingQueue::wake (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  if (m_busy || m_packets.size() == 0) {
+    return;
+  }
+
+  refill(Simulator::Now());
+  uint32_t qci = selectClass();
+  Time wait = getWait(qci);
+  if (!wait.IsZero()) {
+    scheduleWake(wait);
+    return;
+  }
+
+  NS_LOG_LOGIC ("Packet of QCI " << qci << " conforms again");
+  m_waking = true;
+  m_wakeTrace(m_packets.at(qci, 0).packet);
+  m_waking = false;
+}
+
+bool
+ShapingQueue::isFull (uint32_t size) const
+{
+  if (m_mode == QUEUE_MODE_PACKETS)
+    {
+      return m_packets.size() >= m_maxPackets;
+    }
+  return m_bytesInQueue + size >= m_maxBytes;
+}
+
+} // namespace ns3
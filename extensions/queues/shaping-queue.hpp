@@ -0,0 +1,246 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2007 University of Washington
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef SHAPINGQUEUE_H
+#define SHAPINGQUEUE_H
+
+#include <array>
+#include <string>
+#include <vector>
+#include "ns3/packet.h"
+#include "ns3/queue.h"
+#include "ns3/nstime.h"
+#include "ns3/event-id.h"
+#include "ns3/traced-callback.h"
+
+#include "generic-priority-queue.hpp"
+#include "flow-classifier.hpp"
+#include "qci-set.hpp"
+#include "sojourn-stats.hpp"
+
+namespace ns3 {
+
+/**
+ * \ingroup queue
+ *
+ * \brief A priority queue which caps the rate of QCI classes with token buckets
+ *
+ * PriorityQueue and WFQ share the whole link, they cannot keep e.g. the bulk
+ * classes QCI 8 and 9 below 60% of it. The Rates attribute gives classes a
+ * token bucket of a rate and a burst size in bytes, e.g.
+ * "80=300kbps:3000 90=300kbps:3000". A packet of such a class is sent when
+ * its bucket holds its size, or the burst size for packets larger than the
+ * burst, and the size is taken from the bucket. Classes without a bucket
+ * are not shaped. Among the classes which may send, the one of the highest
+ * priority (lowest QCI value) is served first.
+ *
+ * Buckets are refilled when the device asks for a packet, from the time
+ * passed since the last refill, so no timer runs while the device is busy.
+ * Tokens overflowing a full bucket go to a spare bucket, the size of the
+ * largest burst. Classes in BorrowQcis (by default the best-effort classes
+ * 8 and 9) may take tokens from it when their own bucket runs short, so
+ * they use the rate the other shaped classes leave idle, without the shaped
+ * classes exceeding the sum of their rates.
+ *
+ * A point-to-point device asks for its next packet when it finished one,
+ * and goes idle if Dequeue returns none. If no queued packet conforms then,
+ * the packets are held back and a single event is scheduled for the time
+ * the first of them conforms, which fires the Wake trace source.
+ * QueueWakeHelper connects Wake to the device, which sends the packet
+ * right away. A device which is idle also asks for a packet whenever a new
+ * one arrives, and fails without one. If none conforms then, the packet
+ * which conforms first is sent anyway and its class goes into debt: the
+ * bucket turns negative, at most by its burst size, and the class waits
+ * until it paid the debt back. The rates thus hold while the device is
+ * busy, but a class may exceed its rate by up to a burst whenever a packet
+ * arrives at the idle device.
+ */
+class ShapingQueue : public Queue {
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+  /**
+   * \brief ShapingQueue Constructor
+   *
+   * Creates a queue of 100 packets by default which shapes no class
+   */
+  ShapingQueue ();
+
+  virtual ~ShapingQueue();
+
+  /**
+   * Set the operating mode of this device.
+   *
+   * \param mode The operating mode of this device.
+   *
+   */
+  void SetMode (ShapingQueue::QueueMode mode);
+
+  /**
+   * Get the encapsulation mode of this device.
+   *
+   * \returns The encapsulation mode of this device.
+   */
+  ShapingQueue::QueueMode GetMode (void) const;
+
+  /**
+   * \brief Sets the rules which separate traffic flows by name prefix
+   *
+   * \param rules Rules as accepted by ndn::FlowClassifier::setRules
+   */
+  void SetClassifier (std::string rules);
+
+  std::string GetClassifier (void) const;
+
+  /**
+   * \brief Sets the token buckets of the shaped classes
+   *
+   * \param rates List of `qci=rate:burst` entries separated by whitespace,
+   * `,` or `;`. The rate takes the units of DataRate, the burst is in bytes
+   * and defaults to 1500. An empty list shapes no class.
+   *
+   * \throw std::invalid_argument if an entry cannot be parsed
+   */
+  void SetRates (std::string rates);
+
+  std::string GetRates (void) const;
+
+  /**
+   * \brief Sets the classes which may borrow unused tokens
+   *
+   * \param qcis List of QCI values as accepted by QciSet::parse
+   */
+  void SetBorrowQcis (std::string qcis);
+
+  std::string GetBorrowQcis (void) const;
+
+  /**
+   * \return The tokens in bytes of the bucket of a class as of the last refill
+   */
+  double GetTokens (uint32_t qci) const;
+
+  /**
+   * \return The tokens in bytes of the spare bucket as of the last refill
+   */
+  double GetSpareTokens (void) const;
+
+  /**
+   * TracedCallback signature for a queue which has a packet to send again.
+   *
+   * \param [in] packet The packet which conforms now
+   */
+  typedef void (* WakeTracedCallback)(Ptr<const Packet> packet);
+
+protected:
+  virtual void DoDispose (void);
+  virtual bool DoEnqueue (Ptr<Packet> p);
+  virtual Ptr<Packet> DoDequeue (void);
+  virtual Ptr<const Packet> DoPeek (void) const;
+
+private:
+  static const uint32_t CLASSES = ndn::FlowClassifier::QCI_BUCKETS;
+  static const uint32_t NONE = CLASSES; //!< no class is queued
+
+  /**
+   * \brief The token bucket of a shaped class
+   */
+  struct Bucket
+  {
+    double rate = 0;   //!< bytes per second, 0 for classes which are not shaped
+    double burst = 0;  //!< size of the bucket in bytes
+    double tokens = 0; //!< bytes the class may send, negative while the class is in debt
+  };
+
+  /**
+   * \brief Adds the tokens of the time passed since the last refill to the buckets
+   *
+   * Refilling does not change what the queue sends, so Peek refills as well.
+   */
+  void refill (Time now) const;
+
+  /**
+   * \brief Returns the class to serve next, NONE if the queue is empty
+   *
+   * This is the class of the highest priority whose head packet conforms,
+   * or the class whose head packet conforms first if none does.
+   */
+  uint32_t selectClass (void) const;
+
+  /**
+   * \brief Returns the time until the head packet of a queued class conforms
+   */
+  Time getWait (uint32_t qci) const;
+
+  /**
+   * \brief Returns the tokens a packet of a class needs to be sent
+   */
+  double getNeeded (uint32_t qci, uint32_t size) const;
+
+  /**
+   * \brief Schedules Wake for the time the first queued packet conforms
+   */
+  void scheduleWake (Time wait);
+
+  /**
+   * \brief Fires the Wake trace source if a queued packet conforms
+   */
+  void wake (void);
+
+  /**
+   * \brief Whether a packet of the given size exceeds the queue limit
+   */
+  bool isFull (uint32_t size) const;
+
+  /**
+   * \brief A queued packet with the data needed to account its sojourn time
+   */
+  struct Entry
+  {
+    Ptr<Packet> packet;   //!< the queued packet
+    uint64_t flowKey;     //!< flow key as computed by ndn::FlowClassifier
+    Time enqueueTime;     //!< time the packet was enqueued
+  };
+
+  ::PriorityQueue<Entry, ndn::FlowClassifier::QCI_BUCKETS> m_packets; //!< the packets in the queue
+  ndn::FlowClassifier m_classifier;   //!< extracts the QCI class of packets
+  Ptr<SojournStats> m_sojournStats;   //!< sojourn times of the dequeued packets
+  mutable std::array<Bucket, CLASSES> m_buckets; //!< token buckets, indexed by QCI class
+  std::vector<uint32_t> m_shaped;     //!< classes with a token bucket
+  std::string m_rates;                //!< rates as given to SetRates
+  QciSet m_borrowQcis;                //!< classes which may take tokens from the spare bucket
+  mutable double m_spare;             //!< tokens overflowing the full buckets
+  double m_spareBurst;                //!< size of the spare bucket
+  mutable Time m_lastRefill;          //!< time of the last refill
+  bool m_busy;                        //!< whether the device sends the packet of the last Dequeue
+  EventId m_wakeEvent;                //!< pending Wake, if the device found no conforming packet
+  TracedCallback<Ptr<const Packet> > m_wakeTrace; //!< fired when a packet conforms after the device went idle
+  bool m_waking;                      //!< whether Wake is being fired
+  Ptr<Packet> m_woken;                //!< packet dequeued by Wake, which the device enqueues again
+  Ptr<Packet> m_restart;              //!< woken packet enqueued by the device, served first
+  uint32_t m_maxPackets;              //!< max packets in the queue
+  uint32_t m_maxBytes;                //!< max bytes in the queue
+  uint32_t m_bytesInQueue;            //!< actual bytes in the queue
+  QueueMode m_mode;                   //!< queue mode (packets or bytes limited)
+};
+
+} // namespace ns3
+
+#endif /* SHAPINGQUEUE_H */
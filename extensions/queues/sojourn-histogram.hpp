@@ -0,0 +1,206 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef SOJOURNHISTOGRAM_H
+#define SOJOURNHISTOGRAM_H
+
+#include <inttypes.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+#include "ns3/nstime.h"
+
+namespace ns3 {
+
+/**
+ * \brief Log-linear histogram of sojourn times, in the style of HdrHistogram
+ *
+ * Values are counted in nanoseconds. Every power of two range is split into
+ * SUB_BUCKETS equally wide buckets, so a value is known with a relative error
+ * of at most 1 / SUB_BUCKETS, from nanoseconds up to hours. Values below
+ * 2 * SUB_BUCKETS get a bucket each.
+ *
+ * record is O(1). The bucket array only grows up to the largest value seen,
+ * a histogram of sub-second sojourn times takes about 3 KiB.
+ */
+class SojournHistogram
+{
+public:
+  static const uint32_t SUB_BUCKET_BITS = 4;
+  static const uint32_t SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+
+  SojournHistogram ()
+    : m_count (0),
+      m_sum (0),
+      m_min (std::numeric_limits<uint64_t>::max ()),
+      m_max (0)
+  {
+  }
+
+  /**
+   * \brief Counts a sojourn time, negative times count as zero
+   */
+  void
+  record (Time sojourn)
+  {
+    int64_t ns = sojourn.GetNanoSeconds ();
+    uint64_t value = ns > 0 ? ns : 0;
+    uint32_t i = index (value);
+    if (i >= m_counts.size ())
+      {
+        m_counts.resize (i + 1);
+      }
+    m_counts[i]++;
+    m_count++;
+    m_sum += value;
+    m_min = std::min (m_min, value);
+    m_max = std::max (m_max, value);
+  }
+
+  void
+  reset ()
+  {
+    *this = SojournHistogram ();
+  }
+
+  /**
+   * \brief Number of recorded sojourn times
+   */
+  uint64_t
+  count () const
+  {
+    return m_count;
+  }
+
+  Time
+  min () const
+  {
+    return NanoSeconds (m_count == 0 ? 0 : m_min);
+  }
+
+  Time
+  max () const
+  {
+    return NanoSeconds (m_max);
+  }
+
+  Time
+  mean () const
+  {
+    return NanoSeconds (m_count == 0 ? 0 : m_sum / m_count);
+  }
+
+  /**
+   * \brief Returns the sojourn time below or at which the given share of the values lies
+   *
+   * The result is the upper end of the bucket holding the percentile, limited
+   * to the largest value recorded, so it overestimates by at most one bucket.
+   *
+   * \param percent Share of the values in percent, 0 to 100
+   */
+  Time
+  percentile (double percent) const
+  {
+    if (m_count == 0)
+      {
+        return Time ();
+      }
+
+    uint64_t rank = static_cast<uint64_t> (std::ceil (percent / 100 * m_count));
+    rank = std::max<uint64_t> (rank, 1);
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < m_counts.size (); i++)
+      {
+        seen += m_counts[i];
+        if (seen >= rank)
+          {
+            return NanoSeconds (std::max (m_min, std::min (m_max, upperBound (i))));
+          }
+      }
+    return NanoSeconds (m_max);
+  }
+
+  /**
+   * \brief Number of buckets up to the one holding the largest value
+   */
+  uint32_t
+  buckets () const
+  {
+    return m_counts.size ();
+  }
+
+  /**
+   * \brief Number of values in a bucket
+   */
+  uint64_t
+  bucketCount (uint32_t i) const
+  {
+    return m_counts[i];
+  }
+
+  /**
+   * \brief Smallest value in nanoseconds counted by a bucket
+   */
+  static uint64_t
+  lowerBound (uint32_t i)
+  {
+    if (i < 2 * SUB_BUCKETS)
+      {
+        return i;
+      }
+    uint32_t shift = i / SUB_BUCKETS - 1;
+    return uint64_t (i % SUB_BUCKETS + SUB_BUCKETS) << shift;
+  }
+
+  /**
+   * \brief Largest value in nanoseconds counted by a bucket
+   */
+  static uint64_t
+  upperBound (uint32_t i)
+  {
+    return lowerBound (i + 1) - 1;
+  }
+
+private:
+  /**
+   * \brief Returns the bucket of a value
+   *
+   * Below 2 * SUB_BUCKETS, values are their own bucket. Above, the value is
+   * shifted right until SUB_BUCKET_BITS + 1 bits remain, so the bucket is
+   * given by the shift and the remaining bits.
+   */
+  static uint32_t
+  index (uint64_t value)
+  {
+    if (value < 2 * SUB_BUCKETS)
+      {
+        return value;
+      }
+    uint32_t shift = 63 - __builtin_clzll (value) - SUB_BUCKET_BITS;
+    return shift * SUB_BUCKETS + (value >> shift);
+  }
+
+  std::vector<uint64_t> m_counts; //!< number of values in every bucket
+  uint64_t m_count;               //!< number of values
+  uint64_t m_sum;                 //!< sum of the values in nanoseconds
+  uint64_t m_min;                 //!< smallest value in nanoseconds
+  uint64_t m_max;                 //!< largest value in nanoseconds
+};
+
+} // namespace ns3
+
+#endif /* SOJOURNHISTOGRAM_H */
@@ -0,0 +1,153 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/log.h"
+#include "ns3/string.h"
+#include "ns3/uinteger.h"
+#include "ns3/trace-source-accessor.h"
+
+#include <sstream>
+
+#include "sojourn-stats.hpp"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("SojournStats");
+
+NS_OBJECT_ENSURE_REGISTERED (SojournStats);
+
+const uint32_t SojournHistogram::SUB_BUCKET_BITS;
+const uint32_t SojournHistogram::SUB_BUCKETS;
+
+TypeId SojournStats::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::SojournStats")
+    .SetParent<Object> ()
+    .SetGroupName("Network")
+    .AddConstructor<SojournStats> ()
+    .AddAttribute ("MaxFlows",
+                   "The maximum number of traffic flows with an own histogram, 0 disables per-flow histograms.",
+                   UintegerValue (256),
+                   MakeUintegerAccessor (&SojournStats::m_maxFlows),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("Summary",
+                   "Count, mean, percentiles and max of the sojourn time of every QCI class.",
+                   TypeId::ATTR_GET,
+                   StringValue (""),
+                   MakeStringAccessor (&SojournStats::GetSummary),
+                   MakeStringChecker ())
+    .AddTraceSource ("Sojourn",
+                     "A packet left the queue after the given sojourn time.",
+                     MakeTraceSourceAccessor (&SojournStats::m_sojournTrace),
+                     "ns3::SojournStats::SojournTracedCallback")
+  ;
+
+  return tid;
+}
+
+SojournStats::SojournStats () :
+  m_maxFlows (256)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+SojournStats::~SojournStats ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+SojournStats::Record (uint32_t qci, uint64_t flowKey, Time sojourn)
+{
+  m_qci[qci < m_qci.size() ? qci : m_qci.size() - 1].record(sojourn);
+
+  if (flowKey != 0) {
+    auto flow = m_flows.find(flowKey);
+    if (flow != m_flows.end()) {
+      flow->second.record(sojourn);
+    } else if (m_flows.size() < m_maxFlows) {
+      m_flows[flowKey].record(sojourn);
+    }
+  }
+
+  m_sojournTrace(qci, flowKey, sojourn);
+}
+
+const SojournHistogram&
+SojournStats::GetQciHistogram (uint32_t qci) const
+{
+  return m_qci[qci < m_qci.size() ? qci : m_qci.size() - 1];
+}
+
+const SojournHistogram*
+SojournStats::GetFlowHistogram (uint64_t flowKey) const
+{
+  auto flow = m_flows.find(flowKey);
+  return flow == m_flows.end() ? 0 : &flow->second;
+}
+
+uint32_t
+SojournStats::GetNFlows (void) const
+{
+  return m_flows.size();
+}
+
+void
+SojournStats::Reset (void)
+{
+  NS_LOG_FUNCTION (this);
+  for (SojournHistogram& histogram : m_qci) {
+    histogram.reset();
+  }
+  m_flows.clear();
+}
+
+void
+SojournStats::Print (std::ostream& os) const
+{
+  for (uint32_t qci = 0; qci < m_qci.size(); qci++) {
+    const SojournHistogram& histogram = m_qci[qci];
+    if (histogram.count() == 0) {
+      continue;
+    }
+    os << "QCI " << qci
+       << " count " << histogram.count()
+       << " mean " << histogram.mean().GetMicroSeconds() << "us"
+       << " p50 " << histogram.percentile(50).GetMicroSeconds() << "us"
+       << " p90 " << histogram.percentile(90).GetMicroSeconds() << "us"
+       << " p99 " << histogram.percentile(99).GetMicroSeconds() << "us"
+       << " p99.9 " << histogram.percentile(99.9).GetMicroSeconds() << "us"
+       << " max " << histogram.max().GetMicroSeconds() << "us"
+       << std::endl;
+  }
+}
+
+std::string
+SojournStats::GetSummary (void) const
+{
+  std::ostringstream os;
+  Print(os);
+  return os.str();
+}
+
+std::ostream&
+operator<< (std::ostream& os, const SojournStats& stats)
+{
+  stats.Print(os);
+  return os;
+}
+
+} // namespace ns3
@@ -0,0 +1,126 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef SOJOURNSTATS_H
+#define SOJOURNSTATS_H
+
+#include <array>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include "ns3/object.h"
+#include "ns3/nstime.h"
+#include "ns3/traced-callback.h"
+
+#include "flow-classifier.hpp"
+#include "sojourn-histogram.hpp"
+
+namespace ns3 {
+
+/**
+ * \ingroup queue
+ *
+ * \brief Sojourn time histograms of a queue, per QCI class and per traffic flow
+ *
+ * The NDN queues record the time every packet they hand to the device spent
+ * in the queue. Packets dropped from the queue, e.g. by EdfQueue::DropLate or
+ * the CoDel of FqCoDelQueue, are not recorded, so the histograms describe
+ * the delay of the delivered packets only.
+ *
+ * Every queue exposes its statistics through its read-only SojournStats
+ * attribute. The histograms can be polled from there (GetQciHistogram,
+ * GetFlowHistogram, or the Summary attribute with the percentiles of every
+ * class), and the Sojourn trace source reports every recorded packet:
+ *
+ *     Config::ConnectWithoutContext ("/NodeList/0/DeviceList/0/TxQueue/SojournStats/Sojourn", ...);
+ *
+ * Flows are only tracked up to MaxFlows, later flows are counted in their
+ * QCI class only.
+ */
+class SojournStats : public Object {
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+
+  SojournStats ();
+
+  virtual ~SojournStats();
+
+  /**
+   * \brief Records the sojourn time of a packet leaving the queue
+   *
+   * \param qci QCI class of the packet
+   * \param flowKey Flow key as computed by ndn::FlowClassifier, 0 if unknown
+   * \param sojourn Time the packet spent in the queue
+   */
+  void Record (uint32_t qci, uint64_t flowKey, Time sojourn);
+
+  /**
+   * \return The histogram of a QCI class, empty if the class sent no packets
+   */
+  const SojournHistogram& GetQciHistogram (uint32_t qci) const;
+
+  /**
+   * \return The histogram of a traffic flow, 0 if the flow is not tracked
+   *
+   * \param flowKey Flow key as computed by ndn::FlowClassifier
+   */
+  const SojournHistogram* GetFlowHistogram (uint64_t flowKey) const;
+
+  /**
+   * \return The number of tracked traffic flows
+   */
+  uint32_t GetNFlows (void) const;
+
+  /**
+   * \brief Clears all histograms, e.g. at the end of a warm-up phase
+   */
+  void Reset (void);
+
+  /**
+   * \brief Prints count, mean, median, 90th, 99th, 99.9th percentile and max of every QCI class
+   */
+  void Print (std::ostream& os) const;
+
+  /**
+   * \return The output of Print as a string
+   */
+  std::string GetSummary (void) const;
+
+  /**
+   * TracedCallback signature for recorded sojourn times.
+   *
+   * \param [in] qci QCI class of the packet
+   * \param [in] flowKey Flow key of the packet, 0 if unknown
+   * \param [in] sojourn Time the packet spent in the queue
+   */
+  typedef void (* SojournTracedCallback)(uint32_t qci, uint64_t flowKey, Time sojourn);
+
+private:
+  std::array<SojournHistogram, ndn::FlowClassifier::QCI_BUCKETS> m_qci; //!< histogram of every QCI class
+  std::unordered_map<uint64_t, SojournHistogram> m_flows;              //!< histograms of the tracked flows
+  uint32_t m_maxFlows;                                                  //!< max number of tracked flows
+  TracedCallback<uint32_t, uint64_t, Time> m_sojournTrace;              //!< fired for every recorded packet
+};
+
+std::ostream& operator<< (std::ostream& os, const SojournStats& stats);
+
+} // namespace ns3
+
+#endif /* SOJOURNSTATS_H */
@@ -39,19 +39,19 @@ VirtualFinishTimeTag::GetInstanceTypeId() const
 uint32_t
 VirtualFinishTimeTag::GetSerializedSize() const
 {
-  return sizeof(double);
+  return sizeof(uint64_t);
 }
 
 void
 VirtualFinishTimeTag::Serialize(TagBuffer i) const
 {
-  i.WriteDouble(m_virtualFinishTime);
+  i.WriteU64(m_virtualFinishTime);
 }
 
 void
 VirtualFinishTimeTag::Deserialize(TagBuffer i)
 {
-  m_virtualFinishTime = i.ReadDouble();
+  m_virtualFinishTime = i.ReadU64();
 }
 
 void
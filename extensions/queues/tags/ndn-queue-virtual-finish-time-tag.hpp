@@ -27,7 +27,11 @@ namespace ndn {
 
 /**
  * @ingroup ndn-fw
- * @brief Packet tag that is used to track hop count for Interest-Data pairs
+ * @brief Packet tag carrying the virtual finishing time a fair queue assigned to a packet
+ *
+ * FairQueue and WFQ keep the finishing time next to the queued packet and only
+ * attach this tag for external observers if their FinishTimeTag attribute is set.
+ * The time is the fixed point VirtualTime of the queue, in nanoseconds.
  */
 class VirtualFinishTimeTag : public Tag {
 public:
@@ -51,7 +55,7 @@ public:
    * @brief Set new virtual finish time
    */
   void
-  setVirtualFinishTime(double virtualFinishTime)
+  setVirtualFinishTime(uint64_t virtualFinishTime)
   {
     m_virtualFinishTime = virtualFinishTime;
   }
@@ -59,7 +63,7 @@ public:
   /**
    * @brief Get value of virtual finish time
    */
-  double
+  uint64_t
   getVirtualFinishTime() const
   {
     return m_virtualFinishTime;
@@ -88,7 +92,7 @@ public:
   Print(std::ostream& os) const;
 
 private:
-  double m_virtualFinishTime;
+  uint64_t m_virtualFinishTime;
 };
 
 } // namespace ndn
@@ -0,0 +1,53 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef VIRTUALTIME_H
+#define VIRTUALTIME_H
+
+#include <inttypes.h>
+#include "ns3/nstime.h"
+
+namespace ns3 {
+
+/**
+ * \brief Virtual time of the fair queues, a 64 bit fixed point number of nanoseconds
+ *
+ * Virtual start and finishing times are integers, so comparing them is exact
+ * and a simulation produces the same schedule on every platform, however long
+ * it runs. Serving a byte advances the virtual time of a flow by
+ * VIRTUAL_TIME_PER_BYTE, i.e. one byte weighs as much as one millisecond of
+ * real time. The clock wraps after 2^64 ns, about 1.8e13 bytes of backlog of
+ * a single flow.
+ */
+typedef uint64_t VirtualTime;
+
+/**
+ * \brief Virtual time needed to serve one byte
+ */
+const VirtualTime VIRTUAL_TIME_PER_BYTE = 1000000;
+
+/**
+ * \brief Returns the virtual time corresponding to a simulation time
+ */
+inline VirtualTime
+toVirtualTime (Time time)
+{
+  return time.GetNanoSeconds ();
+}
+
+} // namespace ns3
+
+#endif /* VIRTUALTIME_H */
@@ -19,18 +19,13 @@
 #include "ns3/log.h"
 #include "ns3/enum.h"
 #include "ns3/uinteger.h"
-#include "ns3/ppp-header.h"
-#include "ns3/ndnSIM/model/ndn-ns3.hpp"
+#include "ns3/string.h"
+#include "ns3/boolean.h"
+#include "ns3/pointer.h"
 #include "ns3/simulator.h"
 
-#include "utils/ndn-ns3-packet-tag.hpp"
-
-#include <ndn-cxx/encoding/block.hpp>
-#include <ndn-cxx/interest.hpp>
-#include <ndn-cxx/data.hpp>
 #include "wfq.hpp"
 #include "tags/ndn-queue-virtual-finish-time-tag.hpp"
-#include "ns3/ndnSIM/ndn-cxx/encoding/qci.hpp"
 
 namespace ns3 {
 
@@ -61,6 +56,47 @@ TypeId WFQ::GetTypeId (void)
                    UintegerValue (100 * 1024),
                    MakeUintegerAccessor (&WFQ::m_maxBytes),
                    MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("FinishTimeTag",
+                   "Whether queued packets carry a VirtualFinishTimeTag for external observers.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&WFQ::m_finishTimeTag),
+                   MakeBooleanChecker ())
+    .AddAttribute ("DropPolicy",
+                   "Whether a full queue drops the arriving packet or pushes out a queued packet of a lower priority class.",
+                   EnumValue (QUEUE_MODE_TAIL_DROP),
+                   MakeEnumAccessor (&WFQ::SetDropPolicy,
+                                     &WFQ::GetDropPolicy),
+                   MakeEnumChecker (QUEUE_MODE_TAIL_DROP, "QUEUE_MODE_TAIL_DROP",
+                                    QUEUE_MODE_LOWEST_PRIORITY_DROP, "QUEUE_MODE_LOWEST_PRIORITY_DROP"))
+    .AddAttribute ("Classifier",
+                   "Rules for separating traffic flows by name prefix, e.g. \"/=2 /video=4\" (see ndn::FlowClassifier::setRules).",
+                   StringValue (""),
+                   MakeStringAccessor (&WFQ::SetClassifier,
+                                       &WFQ::GetClassifier),
+                   MakeStringChecker ())
+    .AddAttribute ("FreshestQcis",
+                   "Real-time QCI classes whose flows drop their oldest packet instead of an arriving one on overflow, e.g. \"1 3\".",
+                   StringValue (""),
+                   MakeStringAccessor (&WFQ::SetFreshestQcis,
+                                       &WFQ::GetFreshestQcis),
+                   MakeStringChecker ())
+    .AddAttribute ("FreshestMaxPackets",
+                   "The maximum number of packets queued per flow of a FreshestQcis class, 0 for no limit.",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&WFQ::m_freshestMaxPackets),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("SojournStats",
+                   "The sojourn time histograms of the packets leaving this queue, per QCI class and traffic flow.",
+                   TypeId::ATTR_GET,
+                   PointerValue (),
+                   MakePointerAccessor (&WFQ::m_sojournStats),
+                   MakePointerChecker<SojournStats> ())
+    .AddAttribute ("BufferPartition",
+                   "The per-QCI buffer shares of this queue and the trace of its drops per class.",
+                   TypeId::ATTR_GET,
+                   PointerValue (),
+                   MakePointerAccessor (&WFQ::m_bufferPartition),
+                   MakePointerChecker<BufferPartition> ())
   ;
 
   return tid;
@@ -68,10 +104,18 @@ TypeId WFQ::GetTypeId (void)
 
 WFQ::WFQ () :
   Queue (),
-  m_packets (),
-  m_bytesInQueue (0)
+  m_weightSum (0),
+  m_bytesInQueue (0),
+  m_packetsInQueue (0),
+  m_qciPackets (),
+  m_qciBytes (),
+  m_dropPolicy (QUEUE_MODE_TAIL_DROP),
+  m_finishTimeTag (false),
+  m_freshestMaxPackets (0)
 {
   NS_LOG_FUNCTION (this); 
+  m_sojournStats = CreateObject<SojournStats> ();
+  m_bufferPartition = CreateObject<BufferPartition> ();
 }
 
 WFQ::~WFQ ()
@@ -83,6 +127,7 @@ void
 WFQ::SetMode (WFQ::QueueMode mode)
 {
   NS_LOG_FUNCTION (this << mode);
+  NS_ASSERT_MSG (m_packetsInQueue == 0, "Mode cannot change while packets are queued");
   m_mode = mode;
 }
 
@@ -93,87 +138,187 @@ WFQ::GetMode (void) const
   return m_mode;
 }
 
+void
+WFQ::SetClassifier (std::string rules)
+{
+  NS_LOG_FUNCTION (this << rules);
+  m_classifier.setRules(rules);
+}
+
+std::string
+WFQ::GetClassifier (void) const
+{
+  return m_classifier.getRules();
+}
+
+void
+WFQ::SetFreshestQcis (std::string qcis)
+{
+  NS_LOG_FUNCTION (this << qcis);
+  m_freshestQcis.parse(qcis);
+}
+
+std::string
+WFQ::GetFreshestQcis (void) const
+{
+  return m_freshestQcis.str();
+}
+
+void
+WFQ::SetDropPolicy (WFQ::DropPolicy policy)
+{
+  NS_LOG_FUNCTION (this << policy);
+  m_dropPolicy = policy;
+}
+
+WFQ::DropPolicy
+WFQ::GetDropPolicy (void) const
+{
+  NS_LOG_FUNCTION (this);
+  return m_dropPolicy;
+}
+
+uint32_t
+WFQ::GetNFlows (void) const
+{
+  return m_flows.size();
+}
+
+uint32_t
+WFQ::GetNFlowPackets (uint64_t flowKey) const
+{
+  uint32_t flowId = m_flows.find(flowKey);
+  if (flowId == FlowTable::INVALID_FLOW) {
+    return 0;
+  }
+  return m_queues[flowId].size();
+}
+
+uint32_t
+WFQ::GetNQciPackets (uint32_t qci) const
+{
+  return qci < m_qciPackets.size() ? m_qciPackets[qci] : 0;
+}
+
+uint32_t
+WFQ::GetNQciBytes (uint32_t qci) const
+{
+  return qci < m_qciBytes.size() ? m_qciBytes[qci] : 0;
+}
+
 bool 
 WFQ::DoEnqueue (Ptr<Packet> p)
 {
   NS_LOG_FUNCTION (this << p);
 
-  Ptr<Packet> packet = p->Copy();
-
-  PppHeader ppp;
-  packet->RemoveHeader(ppp);
-
-  std::string name = ""; 
-  try {
-    switch (ndn::Convert::getPacketType(packet)) {
-      case ::ndn::tlv::Interest: {
-        std::shared_ptr<const ::ndn::Interest> i = ndn::Convert::FromPacket<::ndn::Interest>(packet);
-        ::ndn::Name prefix = i->getName();
-        prefix = prefix.getPrefix(2); 
-        name = prefix.toUri();
-        break;
-      }
-      case ::ndn::tlv::Data: {
-        std::shared_ptr<const ::ndn::Data> d = ndn::Convert::FromPacket<::ndn::Data>(packet);
-        ::ndn::Name prefix = d->getName();
-        prefix = prefix.getPrefix(2); 
-        name = prefix.toUri();
-        break;
-      }
-      // case ::ndn::tlv::Nack: {
-      //   shared_ptr<const Nack> n = Convert::FromPacket<Nack>(packet);
-      //   this->onReceiveNack(*n);
-      // }
-      default:
-        NS_LOG_ERROR("Unsupported TLV packet");
-    }
-  }
-  catch (const ::ndn::tlv::Error& e) {
-    NS_LOG_ERROR("Unrecognized TLV packet " << e.what());
-  }
+  ndn::FlowInfo info = m_classifier.classify(p);
+  uint64_t flowKey = info.flowKey;
 
-  NS_LOG_DEBUG("Queuing packet with name: " << name);
+  NS_LOG_DEBUG("Queuing packet of flow " << flowKey);
 
   //NS_LOG_FUNCTION()
 
-  if (m_mode == QUEUE_MODE_PACKETS && (countPackets() >= m_maxPackets))
+  // Real-time classes make room by dropping the oldest packets of their own flow
+  uint32_t staleId = FlowTable::INVALID_FLOW;
+  uint32_t stale = 0;
+  uint32_t staleBytes = 0;
+  if (m_freshestQcis.contains(info.qci)) {
+    staleId = m_flows.find(flowKey);
+    stale = countStale(staleId, p->GetSize (), staleBytes);
+  }
+
+  // Classes beyond their buffer share are dropped before they crowd out others.
+  // The share counts the stale packets as gone, and lower priority classes
+  // which borrowed from the shared pool are pushed out to free it.
+  m_bufferPartition->SetLimit(m_mode == QUEUE_MODE_PACKETS ? m_maxPackets : m_maxBytes, m_mode == QUEUE_MODE_BYTES);
+  while (!m_bufferPartition->Admit(info.qci, p->GetSize (), stale, staleBytes))
     {
-      NS_LOG_LOGIC ("Queue full (at max packets) -- droppping pkt");
+      uint32_t lowest = pushOutClass(info.qci);
+      if (lowest != FlowClassIndex::NONE && m_bufferPartition->IsBorrowing(lowest)
+          && m_bufferPartition->FitsMaximum(info.qci, p->GetSize (), stale, staleBytes))
+        {
+          NS_LOG_LOGIC ("Shared buffer pool exhausted -- pushing out pkt of QCI " << lowest);
+          uint32_t flowId = m_tailClasses.firstFlow(lowest);
+          dropTail(flowId);
+          if (flowId == staleId) {
+            // The stale packets were counted in the flow just pushed out, it may be gone
+            staleBytes = 0;
+            if (m_queues[staleId].empty()) {
+              staleId = FlowTable::INVALID_FLOW;
+            }
+            stale = countStale(staleId, p->GetSize (), staleBytes);
+          }
+          continue;
+        }
+
+      NS_LOG_LOGIC ("Buffer share of QCI " << info.qci << " exhausted -- droppping pkt");
+      m_bufferPartition->NotifyDrop (p, info.qci);
       Drop (p);
       return false;
     }
 
-  if (m_mode == QUEUE_MODE_BYTES && (m_bytesInQueue + p->GetSize () >= m_maxBytes))
+  for (; stale > 0; stale--) {
+    NS_LOG_LOGIC ("Fresher pkt arrived -- dropping head pkt of flow " << flowKey);
+    dropHead(staleId);
+  }
+
+  while (isFull(p->GetSize ()))
     {
-      NS_LOG_LOGIC ("Queue full (packet would exceed max bytes) -- droppping pkt");
+      uint32_t lowest = pushOutClass(info.qci);
+      if (lowest != FlowClassIndex::NONE)
+        {
+          NS_LOG_LOGIC ("Queue full -- pushing out pkt of QCI " << lowest);
+          dropTail(m_tailClasses.firstFlow(lowest));
+          continue;
+        }
+
+      NS_LOG_LOGIC ("Queue full -- droppping pkt");
+      m_bufferPartition->NotifyDrop (p, info.qci);
       Drop (p);
       return false;
     }
 
   m_bytesInQueue += p->GetSize ();
-
-  // Check if name is already in queue
-  if (!hasName(name)) {
-    // Create new queue
-    std::pair<std::string, std::deque<Ptr<Packet>>> pair (name, std::deque<Ptr<Packet>>());
-    m_queues.insert(pair);
-    // Create new VirtualFinishTime-Entry
-    std::pair<std::string, uint32_t> finishPair (name, 0);
-    m_virtualFinish.insert(finishPair);
-    // Store name of queue
-    m_queue_names.insert(m_queue_names.end(), name);
+  m_packetsInQueue++;
+  m_qciPackets[info.qci]++;
+  m_qciBytes[info.qci] += p->GetSize ();
+  m_bufferPartition->Add(info.qci, p->GetSize ());
+
+  // Look up the flow, flows without queued packets get a new id
+  bool isNew = false;
+  uint32_t flowId = m_flows.intern(flowKey, isNew);
+  if (flowId >= m_queues.size()) {
+    m_queues.resize(flowId + 1);
+    m_virtualFinish.resize(flowId + 1);
+    m_weight.resize(flowId + 1);
+  }
+  if (isNew) {
+    // The new flow may be served before the selected one
+    m_selected = FlowTable::INVALID_FLOW;
+    m_virtualFinish[flowId] = 0;
+    m_weight[flowId] = getPriority(info.qci);
+    m_weightSum += m_weight[flowId];
+    // New flows wait for their turn behind the active flows
+    if (m_mode == QUEUE_MODE_PACKETS) {
+      m_activeFlows.push_back(flowId);
+    }
   }
   // Add packet to queue
-  auto res = m_queues.find(name);
-  res->second.push_back(p);
+  FlowRing& queue = m_queues[flowId];
+  queue.push_back(p, info.qci, flowKey, Simulator::Now());
+  m_tailClasses.update(flowId, info.qci);
   
-  // updateTime
-  updateTime(p, name);
+  // update virtual finishing time of the queue
+  VirtualTime virFinish = updateTime(flowId);
 
+  // A flow enters the schedule with its first packet, later packets queue behind it
+  if (m_mode == QUEUE_MODE_BYTES && queue.size() == 1) {
+    m_schedule.push(flowId, virFinish);
+  }
 
   NS_LOG_LOGIC ("Number packets " << countPackets());
   NS_LOG_LOGIC ("Number bytes " << m_bytesInQueue);
-  NS_LOG_LOGIC ("Number of queues " << m_queue_names.size());
+  NS_LOG_LOGIC ("Number of queues " << m_flows.size());
 
   return true;
 }
@@ -189,42 +334,50 @@ WFQ::DoDequeue (void)
     return 0;
   }
 
-  if (m_queue_names.size() == 0) {
-    m_currentQueue = 0;
-  } else {
-    if (m_mode == QUEUE_MODE_PACKETS) {
-      m_currentQueue = (m_currentQueue + 1) % (m_queue_names.size());
-    } else if (m_mode == QUEUE_MODE_BYTES) {
-      
-      m_currentQueue = selectQueue();
+  uint32_t flowId = selectQueue();
+  m_selected = FlowTable::INVALID_FLOW;
 
+  NS_LOG_LOGIC("Dequeu Packet from Queue " << m_flows.getKey(flowId));
+  
+  FlowRing& queue = m_queues[flowId];
+  uint32_t qci = queue.qci(0);
+  m_sojournStats->Record(qci, queue.flowKey(0), Simulator::Now() - queue.enqueueTime(0));
+  Ptr<Packet> p = queue.pop_front();
+
+  if (queue.empty()) {
+    NS_LOG_LOGIC("Erase queue for flow " << m_flows.getKey(flowId));
+    m_flows.release(flowId);
+    m_tailClasses.remove(flowId);
+    m_weightSum -= m_weight[flowId];
+    if (m_mode == QUEUE_MODE_PACKETS) {
+      m_activeFlows.erase(flowId);
+    } else {
+      m_schedule.pop();
     }
+  } else if (m_mode == QUEUE_MODE_BYTES) {
+    // The next packet of the flow is now at the head
+    m_schedule.update(flowId, queue.virtualFinish(0));
+  } else {
+    // The flow gets its next turn after all other active flows
+    m_activeFlows.advance();
   }
 
-  std::string name = m_queue_names.at(m_currentQueue);
-  NS_LOG_LOGIC("Dequeu Packet from Queue " << name);
-  
-  auto res = m_queues.find(name);
-  Ptr<Packet> p = res->second.front();
-  res->second.pop_front();
-
-  if (res->second.size() == 0) {
-    NS_LOG_LOGIC("Erase queue for name " << name);
-    m_queues.erase(name);
-    m_virtualFinish.erase(name);
-    m_queue_names.erase(m_queue_names.begin() + m_currentQueue);
+  if (m_finishTimeTag) {
+    ndn::VirtualFinishTimeTag tag;
+    p->RemovePacketTag(tag);
   }
 
-  ndn::VirtualFinishTimeTag tag;
-  p->RemovePacketTag(tag);
-
   m_bytesInQueue -= p->GetSize ();
+  m_packetsInQueue--;
+  m_qciPackets[qci]--;
+  m_qciBytes[qci] -= p->GetSize ();
+  m_bufferPartition->Remove(qci, p->GetSize ());
 
   NS_LOG_LOGIC ("Popped " << p);
 
   NS_LOG_LOGIC ("Number packets " << countPackets());
   NS_LOG_LOGIC ("Number bytes " << m_bytesInQueue);
-  NS_LOG_LOGIC ("Number of queues " << m_queue_names.size());
+  NS_LOG_LOGIC ("Number of queues " << m_flows.size());
 
   return p;
 }
@@ -234,132 +387,206 @@ WFQ::DoPeek (void) const
 {
   NS_LOG_FUNCTION (this);
 
-  if (m_packets.empty ())
+  if (countPackets() == 0)
     {
       NS_LOG_LOGIC ("Queue empty");
       return 0;
     }
 
-  auto currentQueue = m_currentQueue;
-  if (m_queue_names.size() == 0) {
-    currentQueue = 0;
-  } else {
-    if (m_mode == QUEUE_MODE_PACKETS) {
-      currentQueue = (currentQueue + 1) % (m_queue_names.size());
-    } else if (m_mode == QUEUE_MODE_BYTES) {
-      
-      currentQueue = selectQueue();
-
-    }
-  }
-
-  std::string name = m_queue_names.at(currentQueue);
-  NS_LOG_LOGIC("Peek Packet from Queue " << name);
+  uint32_t flowId = selectQueue();
+  NS_LOG_LOGIC("Peek Packet from Queue " << m_flows.getKey(flowId));
   
-  auto res = m_queues.find(name);
-  Ptr<Packet> p = res->second.front();
+  Ptr<Packet> p = m_queues[flowId].packet(0);
 
   NS_LOG_LOGIC ("Number packets " << countPackets());
   NS_LOG_LOGIC ("Number bytes " << m_bytesInQueue);
-  NS_LOG_LOGIC ("Number of queues " << m_queue_names.size());
+  NS_LOG_LOGIC ("Number of queues " << m_flows.size());
 
   return p;
 }
 
-uint
-WFQ::countPackets(void) const
+bool
+WFQ::isFull(uint32_t size) const
 {
-  int size = 0;
-  for (auto it = m_queues.begin(); it != m_queues.end(); ++it) {
-    size += it->second.size();
-  }
-  return size;
+  return isFull(countPackets(), m_bytesInQueue, size);
 }
 
 bool
-WFQ::hasName(std::string name) const
+WFQ::isFull(uint32_t packets, uint32_t bytes, uint32_t size) const
 {
-  auto result = m_queues.find(name);
-  if (result == m_queues.end()) {
-    return false;
+  if (m_mode == QUEUE_MODE_PACKETS) {
+    return packets >= m_maxPackets;
   }
-  return true;
+  return bytes + size >= m_maxBytes;
+}
+
+uint32_t
+WFQ::pushOutClass(uint32_t qci) const
+{
+  // Push out the tail of a flow of the lowest priority class, as long as
+  // that class is of lower priority than the arriving packet
+  uint32_t lowest = m_tailClasses.lastClass();
+  if (m_dropPolicy == QUEUE_MODE_LOWEST_PRIORITY_DROP && lowest != FlowClassIndex::NONE && lowest > qci) {
+    return lowest;
+  }
+  return FlowClassIndex::NONE;
+}
+
+uint32_t
+WFQ::countStale(uint32_t flowId, uint32_t size, uint32_t& staleBytes) const
+{
+  if (flowId == FlowTable::INVALID_FLOW) {
+    return 0;
+  }
+
+  const FlowRing& queue = m_queues[flowId];
+  uint32_t packets = m_packetsInQueue;
+  uint32_t bytes = m_bytesInQueue;
+  uint32_t stale = 0;
+  while (stale < queue.size() &&
+         (isFull(packets, bytes, size) ||
+          (m_freshestMaxPackets > 0 && queue.size() - stale >= m_freshestMaxPackets))) {
+    packets--;
+    bytes -= queue.bytes(stale);
+    stale++;
+  }
+  if (isFull(packets, bytes, size)) {
+    return 0;
+  }
+  staleBytes = m_bytesInQueue - bytes;
+  return stale;
+}
+
+void
+WFQ::dropHead(uint32_t flowId)
+{
+  FlowRing& queue = m_queues[flowId];
+  uint32_t qci = queue.qci(0);
+  Ptr<Packet> p = queue.pop_front();
+  m_selected = FlowTable::INVALID_FLOW;
+
+  if (queue.empty()) {
+    NS_LOG_LOGIC("Erase queue for flow " << m_flows.getKey(flowId));
+    m_flows.release(flowId);
+    m_tailClasses.remove(flowId);
+    m_weightSum -= m_weight[flowId];
+    if (m_mode == QUEUE_MODE_PACKETS) {
+      m_activeFlows.erase(flowId);
+    } else {
+      m_schedule.erase(flowId);
+    }
+  } else if (m_mode == QUEUE_MODE_BYTES) {
+    // The next packet of the flow is now at the head
+    m_schedule.update(flowId, queue.virtualFinish(0));
+  }
+
+  if (m_finishTimeTag) {
+    ndn::VirtualFinishTimeTag tag;
+    p->RemovePacketTag(tag);
+  }
+
+  m_bytesInQueue -= p->GetSize ();
+  m_packetsInQueue--;
+  m_qciPackets[qci]--;
+  m_qciBytes[qci] -= p->GetSize ();
+  m_bufferPartition->Remove(qci, p->GetSize ());
+  m_bufferPartition->NotifyDrop (p, qci);
+
+  DropQueued (p);
 }
 
 void
-WFQ::updateTime(Ptr<const Packet> packet, std::string queueName)
+WFQ::dropTail(uint32_t flowId)
 {
-  double finishRes = m_virtualFinish.find(queueName)->second;
-  uint64_t now = Now().GetMilliSeconds();
-  double virStart = (finishRes < now ? now : finishRes);
-  ndn::VirtualFinishTimeTag tag;
+  FlowRing& queue = m_queues[flowId];
+  uint32_t tail = queue.size() - 1;
+  uint32_t qci = queue.qci(tail);
+
+  // The flow's virtual time continues as if the packet never arrived
+  m_virtualFinish[flowId] = queue.virtualStart(tail);
+  Ptr<Packet> p = queue.pop_back();
+  m_selected = FlowTable::INVALID_FLOW;
+
+  if (queue.empty()) {
+    NS_LOG_LOGIC("Erase queue for flow " << m_flows.getKey(flowId));
+    m_flows.release(flowId);
+    m_tailClasses.remove(flowId);
+    m_weightSum -= m_weight[flowId];
+    if (m_mode == QUEUE_MODE_PACKETS) {
+      m_activeFlows.erase(flowId);
+    } else {
+      m_schedule.erase(flowId);
+    }
+  } else {
+    m_tailClasses.update(flowId, queue.qci(tail - 1));
+  }
 
-  double relation = (double)getPriority(packet) / getCumulatedPriority();
+  if (m_finishTimeTag) {
+    ndn::VirtualFinishTimeTag tag;
+    p->RemovePacketTag(tag);
+  }
 
-  double weightedSize = packet->GetSize() * (1 - relation);
+  m_bytesInQueue -= p->GetSize ();
+  m_packetsInQueue--;
+  m_qciPackets[qci]--;
+  m_qciBytes[qci] -= p->GetSize ();
+  m_bufferPartition->Remove(qci, p->GetSize ());
+  m_bufferPartition->NotifyDrop (p, qci);
 
-  double virFinish = virStart + weightedSize;
-  tag.setVirtualFinishTime(virFinish);
-  packet->AddPacketTag(tag);
-  m_virtualFinish.find(queueName)->second = virFinish;
+  DropQueued (p);
 }
 
 uint
-WFQ::selectQueue() const
+WFQ::countPackets(void) const
 {
-  uint selectedQueue = 0;
-  int i = 0;
-  double minVirFinish = std::numeric_limits<double>::max();
-  for (auto it = m_queue_names.begin(); it != m_queue_names.end(); ++it) {
-    auto queue = m_queues.find(*it)->second;
-    if (queue.size() > 0) {
-      auto packet = queue.front();
-      ndn::VirtualFinishTimeTag tag;
-      packet->RemovePacketTag(tag);
-      double virFinish = tag.getVirtualFinishTime();
-      if (virFinish < minVirFinish) {
-        minVirFinish = virFinish;
-        selectedQueue = i;
-      }
-      packet->AddPacketTag(tag);
-    }
-    i++;
+  return m_packetsInQueue;
+}
+
+VirtualTime
+WFQ::updateTime(uint32_t flowId)
+{
+  FlowRing& queue = m_queues[flowId];
+  VirtualTime finishRes = m_virtualFinish[flowId];
+  VirtualTime now = toVirtualTime(Now());
+  VirtualTime virStart = (finishRes < now ? now : finishRes);
+  uint32_t tail = queue.size() - 1;
+
+  // The size is reduced by the flow's share of the cumulated weight
+  uint64_t cumulated = getCumulatedPriority();
+  VirtualTime weightedSize = queue.bytes(tail) * VIRTUAL_TIME_PER_BYTE;
+  if (cumulated > 0) {
+    weightedSize -= weightedSize * m_weight[flowId] / cumulated;
+  }
+
+  VirtualTime virFinish = virStart + weightedSize;
+  queue.virtualStart(tail) = virStart;
+  queue.virtualFinish(tail) = virFinish;
+  if (m_finishTimeTag) {
+    ndn::VirtualFinishTimeTag tag;
+    tag.setVirtualFinishTime(virFinish);
+    queue.packet(tail)->AddPacketTag(tag);
   }
-  return selectedQueue;
+  m_virtualFinish[flowId] = virFinish;
+  return virFinish;
 }
 
-uint WFQ::getPriority(Ptr<const Packet> p) const
+uint32_t
+WFQ::selectQueue() const
 {
-  Ptr<Packet> packet = p->Copy();
-
-  PppHeader ppp;
-  packet->RemoveHeader(ppp);
-
-  uint32_t prio = ndn::QCI_CLASSES::QCI_9;
-  try {
-    switch (ndn::Convert::getPacketType(packet)) {
-      case ::ndn::tlv::Interest: {
-        std::shared_ptr<const ::ndn::Interest> i = ndn::Convert::FromPacket<::ndn::Interest>(packet);
-        if (i-> getQCI() > 0) {
-          prio = i->getQCI();
-        }
-        break;
-      }
-      case ::ndn::tlv::Data: {
-        std::shared_ptr<const ::ndn::Data> d = ndn::Convert::FromPacket<::ndn::Data>(packet);
-        if (d-> getQCI() > 0) {
-          prio = d->getQCI();
-        }
-        break;
-      }
-      default:
-        NS_LOG_ERROR("Unsupported TLV packet");
-    }
+  if (m_selected != FlowTable::INVALID_FLOW) {
+    return m_selected;
   }
-  catch (const ::ndn::tlv::Error& e) {
-    NS_LOG_ERROR("Unrecognized TLV packet " << e.what());
+  if (m_mode == QUEUE_MODE_BYTES) {
+    m_selected = m_schedule.top();
+  } else {
+    m_selected = m_activeFlows.front();
   }
-  return 100 - prio;
+  return m_selected;
+}
+
+uint WFQ::getPriority(uint32_t qci) const
+{
+  return qci < 100 ? 100 - qci : 0;
 }
 
 } // namespace ns3
@@ -19,11 +19,22 @@
 #ifndef WFQ_H
 #define WFQ_H
 
-#include <queue>
-#include <unordered_map>
+#include <array>
+#include <vector>
+#include <string>
 #include "ns3/packet.h"
 #include "ns3/queue.h"
 
+#include "buffer-partition.hpp"
+#include "flow-class-index.hpp"
+#include "flow-classifier.hpp"
+#include "flow-list.hpp"
+#include "flow-ring.hpp"
+#include "flow-table.hpp"
+#include "indexed-heap.hpp"
+#include "qci-set.hpp"
+#include "sojourn-stats.hpp"
+
 namespace ns3 {
 
 /**
@@ -34,6 +45,20 @@ namespace ns3 {
  * Weighted Fair Queue (WFQ) with Tail-drop Drop-Policy. WFQ combines fairness
  * for traffic flows with service priorities defined by QoS Flags. Therefore
  * WFQ does not starve low priority traffic but considers QoS flags.
+ *
+ * With the QUEUE_MODE_LOWEST_PRIORITY_DROP policy a full queue pushes out the
+ * tail packet of a flow whose tail belongs to the lowest priority QCI class,
+ * as long as that class is of lower priority than the arriving packet.
+ *
+ * For real-time classes listed in FreshestQcis an arriving packet drops the
+ * oldest queued packets of its own flow (head drop) instead of being dropped
+ * or pushing out other flows when the queue is full. FreshestMaxPackets
+ * additionally caps each of these flows.
+ *
+ * The BufferPartition object splits MaxPackets or MaxBytes into per-QCI
+ * shares, a packet beyond the share of its class is dropped on arrival and
+ * does not push out other packets. The Drop trace of the partition reports
+ * every drop of the queue with the class of the packet.
  */
 class WFQ : public Queue {
 public:
@@ -54,6 +79,9 @@ public:
   /**
    * Set the operating mode of this device.
    *
+   * The mode also selects the scheduler (round robin for packets, virtual
+   * finishing time for bytes) and must not change while packets are queued.
+   *
    * \param mode The operating mode of this device.
    *
    */
@@ -66,6 +94,52 @@ public:
    */
   WFQ::QueueMode GetMode (void) const;
 
+  /**
+   * \brief Sets the rules which separate traffic flows by name prefix
+   *
+   * \param rules Rules as accepted by ndn::FlowClassifier::setRules
+   */
+  void SetClassifier (std::string rules);
+
+  std::string GetClassifier (void) const;
+
+  /**
+   * \brief Sets the real-time QCI classes whose flows keep their freshest packets
+   *
+   * \param qcis List of QCI values as accepted by QciSet::parse
+   */
+  void SetFreshestQcis (std::string qcis);
+
+  std::string GetFreshestQcis (void) const;
+
+  void
+  SetDropPolicy (WFQ::DropPolicy policy);
+
+  WFQ::DropPolicy
+  GetDropPolicy (void) const;
+
+  /**
+   * \return The number of traffic flows that currently have packets in the queue
+   */
+  uint32_t GetNFlows (void) const;
+
+  /**
+   * \return The number of packets of the given traffic flow in the queue
+   *
+   * \param flowKey Flow key as computed by ndn::FlowClassifier
+   */
+  uint32_t GetNFlowPackets (uint64_t flowKey) const;
+
+  /**
+   * \return The number of packets of the given QCI class in the queue
+   */
+  uint32_t GetNQciPackets (uint32_t qci) const;
+
+  /**
+   * \return The number of bytes of the given QCI class in the queue
+   */
+  uint32_t GetNQciBytes (uint32_t qci) const;
+
 protected:
   virtual bool DoEnqueue (Ptr<Packet> p);
   virtual Ptr<Packet> DoDequeue (void);
@@ -77,51 +151,100 @@ protected:
   uint countPackets(void) const; 
 
   /**
-   * \brief Checks if queue for the given name exists
+   * \brief Updates virtual finishing time
+   * 
+   * Calculates the virtual start and finishing time of the packet at the tail of the given flow's queue
    *
-   * @param name Name to query
+   * \return The virtual finishing time of the packet
    */
-  bool hasName(std::string name) const;
+  VirtualTime updateTime(uint32_t flowId);
 
   /**
-   * \brief Updates virtual finishing time
-   * 
-   * Calculates the new virtual finishing time for the given queue considering the given packet
+   * \brief Select the next queue to dequeu
+   *
+   * The selection is kept until the schedule changes, so a Peek followed
+   * by a Dequeue selects only once.
+   *
+   * \return The flow id of the selected queue
    */
-  void updateTime(Ptr<const Packet> packet, std::string queueName);
+  uint32_t selectQueue() const;
 
   /**
-   * \brief Select the next queue to dequeu
+   * \brief Whether a packet of the given size exceeds the queue limit
+   */
+  bool isFull(uint32_t size) const;
+
+  /**
+   * \brief Whether a packet of the given size exceeds the limit of a queue with the given content
+   */
+  bool isFull(uint32_t packets, uint32_t bytes, uint32_t size) const;
+
+  /**
+   * \brief Returns the number of head packets to drop for an arriving packet of a FreshestQcis class
+   *
+   * Head packets of the flow are dropped while the queue is full or the
+   * flow holds FreshestMaxPackets. If dropping all of them does not make
+   * room, none is dropped and 0 is returned.
+   *
+   * \param flowId Id of the flow, INVALID_FLOW if the flow has no packets
+   * \param[out] staleBytes Bytes of the packets to drop
+   */
+  uint32_t countStale(uint32_t flowId, uint32_t size, uint32_t& staleBytes) const;
+
+  /**
+   * \brief Returns the class whose packets make room for a packet of the given class
+   *
+   * With QUEUE_MODE_LOWEST_PRIORITY_DROP, this is the lowest priority class
+   * if it is of lower priority than the given one, NONE otherwise.
+   */
+  uint32_t pushOutClass(uint32_t qci) const;
+
+  /**
+   * \brief Removes and drops the head packet of the given flow
+   */
+  void dropHead(uint32_t flowId);
+
+  /**
+   * \brief Removes and drops the tail packet of the given flow
    */
-  uint selectQueue() const;
+  void dropTail(uint32_t flowId);
 
   /**
-   * \brief Fetches the priority of the given packet
+   * \brief Returns the priority (weight) of the given QCI class
    */
-  uint getPriority(Ptr<const Packet> p) const;
+  uint getPriority(uint32_t qci) const;
 
   /**
    * \brief Sums up the priority of all traffic flows
    */
-  inline uint getCumulatedPriority() const
+  inline uint64_t getCumulatedPriority() const
   {
-    uint sum = 0;
-    for (const auto& any : m_queues) {
-      Ptr<const Packet> p = any.second.front();
-      sum += getPriority(p);
-    }
-    return sum;
+    return m_weightSum;
   }
 
-  std::queue<Ptr<Packet> > m_packets; //!< the packets in the queue
-  std::unordered_map<std::string, std::deque<Ptr<Packet>>> m_queues;
-  std::vector<std::string> m_queue_names;
-  std::unordered_map<std::string, double> m_virtualFinish;
-  uint32_t m_currentQueue = 0;
+  FlowTable m_flows;                  //!< dense ids of the traffic flows with queued packets
+  std::vector<FlowRing> m_queues;     //!< queues of all traffic flows, indexed by flow id
+  std::vector<VirtualTime> m_virtualFinish; //!< virtual finishing time of the last packet, indexed by flow id
+  std::vector<uint32_t> m_weight;     //!< priority of every flow, taken from its first packet, indexed by flow id
+  uint64_t m_weightSum;               //!< sum of the priorities of all flows with queued packets
+  FlowList m_activeFlows;             //!< flows with queued packets in round robin order (packet mode)
+  IndexedHeap<VirtualTime> m_schedule; //!< flows ordered by virtual finishing time of their head packet (byte mode)
+  FlowClassIndex m_tailClasses;       //!< flows grouped by the QCI class of their tail packet
+  ndn::FlowClassifier m_classifier;  //!< maps packets to traffic flows
+  Ptr<SojournStats> m_sojournStats;   //!< sojourn times of the dequeued packets
+  Ptr<BufferPartition> m_bufferPartition; //!< per-QCI buffer shares and class drop trace
+  mutable uint32_t m_selected = FlowTable::INVALID_FLOW; //!< flow returned by selectQueue, INVALID_FLOW after the schedule changed
   uint32_t m_maxPackets;              //!< max packets in the queue
   uint32_t m_maxBytes;                //!< max bytes in the queue
   uint32_t m_bytesInQueue;            //!< actual bytes in the queue
+  uint32_t m_packetsInQueue;          //!< actual packets in the queue
+  std::array<uint32_t, ndn::FlowClassifier::QCI_BUCKETS> m_qciPackets; //!< packets in the queue per QCI class
+  std::array<uint32_t, ndn::FlowClassifier::QCI_BUCKETS> m_qciBytes;   //!< bytes in the queue per QCI class
   QueueMode m_mode;                   //!< queue mode (packets or bytes limited)
+  WFQ::DropPolicy m_dropPolicy;       //!< drop the arriving packet or push out lower priority packets
+  bool m_finishTimeTag;               //!< attach VirtualFinishTimeTag to queued packets
+  QciSet m_freshestQcis;              //!< real-time classes whose flows drop their oldest packets first
+  uint32_t m_freshestMaxPackets;      //!< max packets of a flow of a FreshestQcis class, 0 for no cap
 };
 
 } // namespace ns3
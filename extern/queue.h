@@ -190,6 +190,19 @@ protected:
    */
   void Drop (Ptr<Packet> packet);
 
+  /**
+   *  \brief Drop a packet which was already enqueued
+   *  \param packet packet that was removed from the queue and dropped
+   *  Like Drop, but also removes the packet from the bytes and packets in the queue.
+   *  Used by subclasses which evict queued packets (push-out or head drop).
+   */
+  void DropQueued (Ptr<Packet> packet)
+  {
+    m_nBytes -= packet->GetSize ();
+    m_nPackets--;
+    Drop (packet);
+  }
+
   /// Traced callback: fired when a packet is enqueued
   TracedCallback<Ptr<const Packet> > m_traceEnqueue;
   /// Traced callback: fired when a packet is dequeued
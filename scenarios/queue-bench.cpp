@@ -0,0 +1,367 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+ * Copyright (c) 2011-2015  Regents of the University of California.
+ *
+ * This file is part of ndnSIM. See AUTHORS for complete list of ndnSIM authors and
+ * contributors.
+ *
+ * ndnSIM is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * ndnSIM is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ndnSIM, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+// queue-bench.cpp
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/point-to-point-module.h"
+#include "ns3/ndnSIM-module.h"
+#include "ns3/ppp-header.h"
+
+#include "queues/fair-queue.hpp"
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <new>
+#include <random>
+#include <sstream>
+#include <vector>
+
+// Heap allocations of the whole process, including ns-3 and the queues. The global
+// operator new is replaced below, so every allocation passes through this counter.
+static uint64_t g_allocations = 0;
+
+void*
+operator new(size_t size)
+{
+  g_allocations++;
+  void* memory = std::malloc(size == 0 ? 1 : size);
+  if (memory == nullptr) {
+    throw std::bad_alloc();
+  }
+  return memory;
+}
+
+void*
+operator new[](size_t size)
+{
+  return operator new(size);
+}
+
+void
+operator delete(void* memory) noexcept
+{
+  std::free(memory);
+}
+
+void
+operator delete[](void* memory) noexcept
+{
+  std::free(memory);
+}
+
+namespace ns3 {
+
+/**
+ * This scenario measures the per-packet cost of the queue disciplines without
+ * running a simulation.
+ *
+ * A pool of Interest and Data packets is encoded before any measurement. The
+ * flows are spread over Prefixes name prefixes (/prefix-<p>/flow-<f>/<seq>),
+ * every flow gets a QCI class drawn from QciMix, every packet is an Interest
+ * with probability InterestRatio and otherwise a Data packet with a payload
+ * size drawn from PayloadSizes. Mixes are lists of value:weight pairs, e.g.
+ * "1:1,5:1,9:8".
+ *
+ * For an increasing number of flows (1, 10, ..., MaxFlows), each queue is
+ * filled with PacketsPerFlow packets per flow, so that all flows are active.
+ * Afterwards every operation dequeues the next packet and enqueues it again,
+ * which keeps the number of active flows constant. For every run, the time
+ * and the heap allocations per operation are reported, as well as the peak
+ * resident set size of the run (on Linux, otherwise of the whole process).
+ *
+ * Queues with a size limit are unbounded and count in Mode, either "bytes" or
+ * "packets", which selects e.g. the byte or the packet round robin of the
+ * DrrQueue. Queues without these attributes keep their own configuration.
+ *
+ *     ./waf --run "queue-bench --MaxFlows=100000 --Operations=1000000"
+ *     ./waf --run "queue-bench --Queues=ns3::DrrQueue --QciMix=1:1,9:4 --PayloadSizes=100:3,8000:1"
+ *     ./waf --run "queue-bench --Queues=ns3::DrrQueue,ns3::InterestShaperQueue --Mode=packets"
+ */
+
+/**
+ * Parses a list of value:weight pairs, a value without weight weighs 1
+ */
+static void
+ParseMix(const std::string& name, const std::string& mix, std::vector<uint32_t>& values,
+         std::vector<double>& weights)
+{
+  std::string entries = mix;
+  std::replace(entries.begin(), entries.end(), ',', ' ');
+  std::istringstream is(entries);
+  std::string entry;
+  while (is >> entry) {
+    size_t separator = entry.find(':');
+    try {
+      values.push_back(std::stoul(entry.substr(0, separator)));
+      weights.push_back(separator == std::string::npos ? 1.0 : std::stod(entry.substr(separator + 1)));
+    }
+    catch (const std::logic_error&) {
+      NS_FATAL_ERROR(name << " entry `" << entry << "` is not of the form value:weight");
+    }
+  }
+  NS_ABORT_MSG_IF(values.empty(), name << " must not be empty");
+}
+
+static Ptr<Packet>
+MakePacket(const ::ndn::Block& wire)
+{
+  Ptr<Packet> packet = Create<Packet>(wire.wire(), wire.size());
+  packet->AddHeader(PppHeader());
+  return packet;
+}
+
+static Ptr<Packet>
+MakeInterest(const ::ndn::Name& name, uint32_t qci, uint32_t nonce)
+{
+  ::ndn::Interest interest(name);
+  interest.setNonce(nonce);
+  if (qci != 0) {
+    interest.setQCI(qci);
+  }
+  return MakePacket(interest.wireEncode());
+}
+
+static Ptr<Packet>
+MakeData(const ::ndn::Name& name, uint32_t qci, uint32_t payloadSize)
+{
+  ::ndn::Data data(name);
+  data.setContent(std::make_shared< ::ndn::Buffer>(payloadSize));
+  if (qci != 0) {
+    data.setQCI(qci);
+  }
+
+  ::ndn::Signature signature;
+  ::ndn::SignatureInfo signatureInfo(static_cast< ::ndn::tlv::SignatureTypeValue>(255));
+  signature.setInfo(signatureInfo);
+  signature.setValue(::ndn::nonNegativeIntegerBlock(::ndn::tlv::SignatureValue, 0));
+  data.setSignature(signature);
+
+  return MakePacket(data.wireEncode());
+}
+
+/**
+ * Resets the peak resident set size, so that it covers the next run only
+ */
+static void
+ResetPeakRss()
+{
+#ifdef __linux__
+  // Supported since Linux 4.0, older kernels keep the peak of the whole process
+  std::ofstream clearRefs("/proc/self/clear_refs");
+  clearRefs << "5";
+#endif
+}
+
+/**
+ * Returns the peak resident set size in KiB
+ */
+static uint64_t
+PeakRss()
+{
+#ifdef __linux__
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    if (line.compare(0, 6, "VmHWM:") == 0) {
+      return std::stoull(line.substr(6));
+    }
+  }
+#endif
+
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+  return usage.ru_maxrss / 1024;
+#else
+  return usage.ru_maxrss;
+#endif
+}
+
+struct BenchResult
+{
+  double nsPerOp;
+  double allocationsPerOp;
+  uint64_t peakRss;
+};
+
+/**
+ * Runs the benchmark with the first flows of the packet pool
+ *
+ * @param mode Mode of the queues which have a size limit
+ * @param pool Packets of every flow, packet seq of flow f at f * packetsPerFlow + seq
+ */
+static BenchResult
+RunBench(const std::string& queueType, Queue::QueueMode mode,
+         const std::vector<Ptr<Packet>>& pool, uint32_t flows, uint32_t packetsPerFlow,
+         uint32_t operations)
+{
+  ResetPeakRss();
+
+  ObjectFactory factory;
+  factory.SetTypeId(queueType);
+  // Setting an attribute the queue does not have aborts, e.g. for the InterestShaperQueue
+  TypeId typeId = TypeId::LookupByName(queueType);
+  TypeId::AttributeInformation info;
+  if (typeId.LookupAttributeByName("Mode", &info)) {
+    factory.Set("Mode", EnumValue(mode));
+  }
+  if (typeId.LookupAttributeByName("MaxPackets", &info)) {
+    factory.Set("MaxPackets", UintegerValue(std::numeric_limits<uint32_t>::max()));
+  }
+  if (typeId.LookupAttributeByName("MaxBytes", &info)) {
+    factory.Set("MaxBytes", UintegerValue(std::numeric_limits<uint32_t>::max()));
+  }
+  Ptr<Queue> queue = factory.Create<Queue>();
+
+  // Queues may tag the packets, the pool is reused by the next runs
+  for (uint32_t seq = 0; seq < packetsPerFlow; seq++) {
+    for (uint32_t flow = 0; flow < flows; flow++) {
+      queue->Enqueue(pool[flow * packetsPerFlow + seq]->Copy());
+    }
+  }
+
+  uint64_t allocations = g_allocations;
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < operations; i++) {
+    Ptr<Packet> packet = queue->Dequeue();
+    queue->Enqueue(packet);
+  }
+  auto end = std::chrono::steady_clock::now();
+  allocations = g_allocations - allocations;
+
+  BenchResult result;
+  result.nsPerOp = std::chrono::duration<double, std::nano>(end - start).count() / operations;
+  result.allocationsPerOp = static_cast<double>(allocations) / operations;
+  result.peakRss = PeakRss();
+
+  queue->DequeueAll();
+  return result;
+}
+
+int
+main(int argc, char* argv[])
+{
+  std::string queues = "ns3::FairQueue,ns3::WFQ,ns3::PriorityQueue,ns3::DrrQueue";
+  uint32_t maxFlows = 100000;
+  uint32_t prefixes = 100;
+  uint32_t packetsPerFlow = 2;
+  double interestRatio = 0.5;
+  std::string qciMix = "9";
+  std::string payloadSizes = "100";
+  uint32_t operations = 1000000;
+  uint32_t seed = 1;
+  std::string mode = "bytes";
+
+  CommandLine cmd;
+  cmd.AddValue("Queues", "Comma separated queue types to measure", queues);
+  cmd.AddValue("MaxFlows", "Largest number of active flows", maxFlows);
+  cmd.AddValue("Prefixes", "Number of name prefixes the flows are spread over", prefixes);
+  cmd.AddValue("PacketsPerFlow", "Packets queued per flow", packetsPerFlow);
+  cmd.AddValue("InterestRatio", "Fraction of Interests among the packets", interestRatio);
+  cmd.AddValue("QciMix", "QCI classes of the flows as qci:weight pairs", qciMix);
+  cmd.AddValue("PayloadSizes", "Content sizes of the Data packets as size:weight pairs",
+               payloadSizes);
+  cmd.AddValue("Operations", "Dequeue/Enqueue pairs measured per run", operations);
+  cmd.AddValue("Seed", "Seed of the packet pool generation", seed);
+  cmd.AddValue("Mode", "Mode of the queues with a size limit, bytes or packets", mode);
+  cmd.Parse(argc, argv);
+
+  NS_ABORT_MSG_IF(maxFlows == 0 || prefixes == 0 || packetsPerFlow == 0 || operations == 0,
+                  "MaxFlows, Prefixes, PacketsPerFlow and Operations must be positive");
+  NS_ABORT_MSG_IF(mode != "bytes" && mode != "packets", "Mode must be bytes or packets");
+  Queue::QueueMode queueMode =
+    mode == "bytes" ? Queue::QUEUE_MODE_BYTES : Queue::QUEUE_MODE_PACKETS;
+
+  std::vector<uint32_t> qcis;
+  std::vector<double> qciWeights;
+  ParseMix("QciMix", qciMix, qcis, qciWeights);
+  std::vector<uint32_t> sizes;
+  std::vector<double> sizeWeights;
+  ParseMix("PayloadSizes", payloadSizes, sizes, sizeWeights);
+
+  std::vector<std::string> queueTypes;
+  std::string entries = queues;
+  std::replace(entries.begin(), entries.end(), ',', ' ');
+  std::istringstream is(entries);
+  for (std::string queueType; is >> queueType;) {
+    queueTypes.push_back(queueType);
+  }
+
+  // Encode all packets up front, so the measurement only covers the queues
+  std::mt19937 random(seed);
+  std::discrete_distribution<size_t> qciDistribution(qciWeights.begin(), qciWeights.end());
+  std::discrete_distribution<size_t> sizeDistribution(sizeWeights.begin(), sizeWeights.end());
+  std::bernoulli_distribution interestDistribution(interestRatio);
+
+  std::vector<Ptr<Packet>> pool;
+  pool.reserve(static_cast<size_t>(maxFlows) * packetsPerFlow);
+  for (uint32_t flow = 0; flow < maxFlows; flow++) {
+    ::ndn::Name prefix("/prefix-" + std::to_string(flow % prefixes));
+    prefix.append("flow-" + std::to_string(flow));
+    uint32_t qci = qcis[qciDistribution(random)];
+    for (uint32_t seq = 0; seq < packetsPerFlow; seq++) {
+      ::ndn::Name name(prefix);
+      name.appendSequenceNumber(seq);
+      if (interestDistribution(random)) {
+        pool.push_back(MakeInterest(name, qci, random()));
+      }
+      else {
+        pool.push_back(MakeData(name, qci, sizes[sizeDistribution(random)]));
+      }
+    }
+  }
+
+  std::cout << "# " << pool.size() << " packets encoded, peak RSS " << PeakRss() / 1024
+            << " MiB" << std::endl;
+  std::cout << std::setw(24) << "Queue" << std::setw(10) << "Flows" << std::setw(12) << "ns/op"
+            << std::setw(12) << "allocs/op" << std::setw(14) << "peak RSS MiB" << std::endl;
+  for (const std::string& queueType : queueTypes) {
+    // Powers of ten up to MaxFlows, and MaxFlows itself as the last step
+    for (uint32_t flows = 1;; flows = std::min<uint64_t>(flows * 10ull, maxFlows)) {
+      BenchResult result = RunBench(queueType, queueMode, pool, flows, packetsPerFlow,
+                                    operations);
+      std::cout << std::setw(24) << queueType << std::setw(10) << flows << std::fixed
+                << std::setw(12) << std::setprecision(1) << result.nsPerOp << std::setw(12)
+                << std::setprecision(2) << result.allocationsPerOp << std::setw(14)
+                << std::setprecision(1) << result.peakRss / 1024.0 << std::endl;
+      if (flows == maxFlows) {
+        break;
+      }
+    }
+  }
+
+  return 0;
+}
+
+} // namespace ns3
+
+int
+main(int argc, char* argv[])
+{
+  return ns3::main(argc, argv);
+}